@@ -0,0 +1,222 @@
+//
+//  Bench.c
+//  OpenDMX
+//
+//  Microbenchmarks for the hot paths of libOpenDMX. Built against the virtual backend by `make bench`.
+//  Results are printed as one JSON object per line so that they can be collected and compared across releases.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "../OpenDMX.h"
+#include "../LinkedList.h"
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// MARK: Slots
+static void bench_set_slot (void *context, long iterations) {
+    opendmx_device *device = context;
+    for (long i = 0; i < iterations; i++) {
+        for (int slot = 0; slot < OPENDMX_UNIVERSE_LENGTH; slot++) {
+            opendmx_set_slot(device, slot, (uint8_t)(i + slot));
+        }
+    }
+}
+
+static void bench_get_slot (void *context, long iterations) {
+    opendmx_device *device = context;
+    unsigned long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        for (int slot = 0; slot < OPENDMX_UNIVERSE_LENGTH; slot++) {
+            sum += opendmx_get_slot(device, slot);
+        }
+    }
+    sink = sum;
+}
+
+static void bench_set_slots (void *context, long iterations) {
+    opendmx_device *device = context;
+    uint8_t values[OPENDMX_UNIVERSE_LENGTH];
+    for (long i = 0; i < iterations; i++) {
+        memset(values, (int)i, sizeof(values));
+        opendmx_set_slots(device, 0, values, OPENDMX_UNIVERSE_LENGTH);
+    }
+}
+
+static void bench_get_slots (void *context, long iterations) {
+    opendmx_device *device = context;
+    uint8_t values[OPENDMX_UNIVERSE_LENGTH];
+    for (long i = 0; i < iterations; i++) {
+        opendmx_get_slots(device, 0, values, OPENDMX_UNIVERSE_LENGTH);
+    }
+    sink = values[0];
+}
+
+// MARK: Frame Assembly
+static void bench_render_frame (void *context, long iterations) {
+    opendmx_device *device = context;
+    uint8_t frame[OPENDMX_UNIVERSE_LENGTH];
+    for (long i = 0; i < iterations; i++) {
+        opendmx_render_frame(device, frame);
+    }
+    sink = frame[0];
+}
+
+static void set_curves (opendmx_device *device, int count) {
+    uint8_t curve[256];
+    const int width = OPENDMX_UNIVERSE_LENGTH / count;
+    for (int i = 0; i < count; i++) {
+        opendmx_curve_build(curve, 1.5 + i * 0.1, 0, 255);
+        opendmx_set_curve(device, i * width, width, curve);
+    }
+}
+
+static void add_effects (opendmx_device *device, int count, int width) {
+    for (int i = 0; i < count; i++) {
+        struct opendmx_effect effect = {
+            .waveform = i % 4,
+            .compose = i % 3,
+            .first_slot = (i * width) % (OPENDMX_UNIVERSE_LENGTH - width),
+            .count = width,
+            .period = 1000000000 + i * 1000,
+            .phase = i * 100,
+            .phase_step = 65536 / width,
+            .duty = 32768,
+            .low = 0,
+            .high = 255
+        };
+        opendmx_add_effect(device, &effect);
+    }
+}
+
+// MARK: Scheduled Changes
+#define SCHEDULE_LENGTH 10000
+
+static void bench_schedule_slots (void *context, long iterations) {
+    opendmx_device *device = context;
+    const uint8_t values[4] = { 1, 2, 3, 4 };
+    for (long i = 0; i < iterations; i++) {
+        for (int j = 0; j < SCHEDULE_LENGTH; j++) {
+            const uint64_t time = (uint64_t)((j * 7919) % SCHEDULE_LENGTH) * 1000000;   // Out of order times
+            opendmx_schedule_slots(device, time, j % (OPENDMX_UNIVERSE_LENGTH - 4), values, 4);
+        }
+        opendmx_clear_schedule(device);
+    }
+}
+
+// MARK: Input
+struct input_stream {
+    opendmx_input   *input;
+    uint8_t         bytes[4 + OPENDMX_UNIVERSE_LENGTH * 2];  // A break, the start code and a universe with every 0xFF escaped
+    int             length;
+};
+
+static void bench_input_feed (void *context, long iterations) {
+    struct input_stream *stream = context;
+    struct opendmx_input_frame frame;
+    for (long i = 0; i < iterations; i++) {
+        opendmx_input_feed(stream->input, stream->bytes, stream->length);
+        opendmx_input_read_frame(stream->input, &frame);
+    }
+    sink = frame.slots[0];
+}
+
+// MARK: LinkedList
+#define LIST_LENGTH 64
+
+static void bench_list_append_free (void *context, long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        struct list list = { NULL, 0 };
+        for (int j = 0; j < LIST_LENGTH; j++) {
+            list_append(&list, 16);
+        }
+        list_free(&list);
+    }
+}
+
+static void bench_list_get (void *context, long iterations) {
+    struct list *list = context;
+    unsigned long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        sum += (unsigned long)list_get(list, (int)(i % LIST_LENGTH));
+    }
+    sink = sum;
+}
+
+static void bench_list_iterate (void *context, long iterations) {
+    struct list *list = context;
+    unsigned long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        struct list_iterator *iter = list_iterator(list);
+        while (list_iterator_has_next(iter)) {
+            sum += (unsigned long)list_iterator_next(iter);
+        }
+        free(iter);
+    }
+    sink = sum;
+}
+
+int main (int argc, char **argv) {
+    opendmx_device *device = opendmx_open_device("virtual0");
+    if (device == NULL) {
+        fprintf(stderr, "Failed to open virtual device\n");
+        return 1;
+    }
+
+    bench("set_slot", bench_set_slot, device, OPENDMX_UNIVERSE_LENGTH);
+    bench("get_slot", bench_get_slot, device, OPENDMX_UNIVERSE_LENGTH);
+    bench("set_slots_universe", bench_set_slots, device, 1);
+    bench("get_slots_universe", bench_get_slots, device, 1);
+
+    bench("render_frame", bench_render_frame, device, 1);
+    set_curves(device, 4);
+    bench("render_frame_curves_4", bench_render_frame, device, 1);
+    set_curves(device, OPENDMX_MAX_CURVES);
+    bench("render_frame_curves_max", bench_render_frame, device, 1);
+    opendmx_set_curve(device, 0, OPENDMX_UNIVERSE_LENGTH, NULL);
+    add_effects(device, 100, 16);
+    bench("render_frame_effects_100x16", bench_render_frame, device, 1);
+    add_effects(device, 200, 16);
+    bench("render_frame_effects_300x16", bench_render_frame, device, 1);
+    bench("schedule_slots_10000", bench_schedule_slots, device, SCHEDULE_LENGTH);
+    opendmx_close_device(device);
+
+    // Shared universes, written through a client attached to the segment
+    char name[64];
+    snprintf(name, sizeof(name), "/opendmx-bench-%d", (int)getpid());
+    device = opendmx_open_device("virtual0");
+    if (opendmx_share_universe(device, name) == 0) {
+        opendmx_device *client = opendmx_attach_universe(name);
+        bench("shared_set_slot", bench_set_slot, client, OPENDMX_UNIVERSE_LENGTH);
+        bench("shared_set_slots_universe", bench_set_slots, client, 1);
+        bench("shared_render_frame", bench_render_frame, device, 1);
+        opendmx_close_device(client);
+    } else {
+        fprintf(stderr, "Failed to share universe, skipping shared universe benchmarks\n");
+    }
+    opendmx_close_device(device);
+
+    struct input_stream stream = { opendmx_open_input(NULL), { 0xFF, 0x00, 0x00, 0x00 }, 4 };
+    for (int slot = 0; slot < OPENDMX_UNIVERSE_LENGTH; slot++) {
+        stream.bytes[stream.length++] = (uint8_t)slot;
+        if ((uint8_t)slot == 0xFF) stream.bytes[stream.length++] = 0xFF;
+    }
+    bench("input_feed_frame", bench_input_feed, &stream, 1);
+    opendmx_close_input(stream.input);
+
+    struct list list = { NULL, 0 };
+    for (int j = 0; j < LIST_LENGTH; j++) {
+        list_append(&list, 16);
+    }
+    bench("list_append_free_64", bench_list_append_free, NULL, LIST_LENGTH);
+    bench("list_get_64", bench_list_get, &list, 1);
+    bench("list_iterate_64", bench_list_iterate, &list, LIST_LENGTH);
+    list_free(&list);
+
+    return 0;
+}
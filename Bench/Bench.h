@@ -0,0 +1,59 @@
+//
+//  Bench.h
+//  OpenDMX
+//
+//  The timing harness shared by the benchmarks. Everything is static so that each benchmark program includes its own copy,
+//  it is also valid C++ so that the C++ bindings can be measured with the same harness as the C API.
+//
+
+#ifndef Bench_h
+#define Bench_h
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_MIN_TIME  50000000    // Minimum run time of a trial in nanoseconds
+#define BENCH_TRIALS    5
+
+typedef void (*bench_function) (void *context, long iterations);
+
+static volatile unsigned long sink;    // Results are written here so that they are not optimized away
+
+static long long now (void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static long long time_run (bench_function function, void *context, long iterations) {
+    long long start = now();
+    function(context, iterations);
+    return now() - start;
+}
+
+/**
+ *  Run a benchmark and print its result.
+ *  @param name The name of the benchmark.
+ *  @param function The function to be timed, it must perform its operation the given number of times.
+ *  @param context Passed to the function.
+ *  @param ops_per_iteration The number of operations performed by each iteration of the function.
+ */
+static void bench (const char *name, bench_function function, void *context, int ops_per_iteration) {
+    // Find an iteration count which runs for long enough to time accurately
+    long iterations = 1;
+    while (time_run(function, context, iterations) < BENCH_MIN_TIME) {
+        iterations *= 2;
+    }
+    // Report the fastest trial, it is the one least disturbed by the rest of the system
+    long long best = -1;
+    for (int i = 0; i < BENCH_TRIALS; i++) {
+        long long elapsed = time_run(function, context, iterations);
+        if ((best < 0) || (elapsed < best)) best = elapsed;
+    }
+    double ops = (double)iterations * ops_per_iteration;
+    printf("{\"benchmark\": \"%s\", \"iterations\": %ld, \"ops_per_iteration\": %d, \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f}\n",
+           name, iterations, ops_per_iteration, best / ops, ops * 1e9 / best);
+    fflush(stdout);
+}
+
+#endif /* Bench_h */
@@ -0,0 +1,191 @@
+//
+//  BenchCpp.cpp
+//  OpenDMX
+//
+//  Compares the C++ bindings in OpenDMX.hpp with the C calls they wrap, each c_ benchmark does the same work as the cpp_
+//  benchmark after it so the two results should match. Built against the virtual backend by `make bench`.
+//
+
+#include "../OpenDMX.hpp"
+#include "Bench.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <unistd.h>
+
+using RGBW = std::array<std::uint8_t, 4>;
+
+// Four RGBW fixtures spread across the universe
+using Fixture1 = opendmx::Patch<0, 4>;
+using Fixture2 = opendmx::Patch<100, 4>;
+using Fixture3 = opendmx::Patch<200, 4>;
+using Fixture4 = opendmx::Patch<508, 4>;
+
+// MARK: Slots
+static void c_set_slot (void *context, long iterations) {
+    opendmx_device *device = static_cast<opendmx_device *>(context);
+    for (long i = 0; i < iterations; i++) {
+        for (int slot = 0; slot < OPENDMX_UNIVERSE_LENGTH; slot++) {
+            opendmx_set_slot(device, slot, (uint8_t)(i + slot));
+        }
+    }
+}
+
+static void cpp_set_slot (void *context, long iterations) {
+    opendmx::Device &device = *static_cast<opendmx::Device *>(context);
+    for (long i = 0; i < iterations; i++) {
+        for (int slot = 0; slot < OPENDMX_UNIVERSE_LENGTH; slot++) {
+            device.set_slot(slot, (uint8_t)(i + slot));
+        }
+    }
+}
+
+static void c_set_slots (void *context, long iterations) {
+    opendmx_device *device = static_cast<opendmx_device *>(context);
+    uint8_t values[OPENDMX_UNIVERSE_LENGTH];
+    for (long i = 0; i < iterations; i++) {
+        memset(values, (int)i, sizeof(values));
+        opendmx_set_slots(device, 0, values, OPENDMX_UNIVERSE_LENGTH);
+    }
+}
+
+static void cpp_write (void *context, long iterations) {
+    opendmx::Device &device = *static_cast<opendmx::Device *>(context);
+    std::array<std::uint8_t, opendmx::universe_length> values;
+    for (long i = 0; i < iterations; i++) {
+        values.fill((uint8_t)i);
+        device.write(0, values);
+    }
+}
+
+static void c_get_slots (void *context, long iterations) {
+    opendmx_device *device = static_cast<opendmx_device *>(context);
+    uint8_t values[OPENDMX_UNIVERSE_LENGTH];
+    for (long i = 0; i < iterations; i++) {
+        opendmx_get_slots(device, 0, values, OPENDMX_UNIVERSE_LENGTH);
+    }
+    sink = values[0];
+}
+
+static void cpp_read (void *context, long iterations) {
+    const opendmx::Device &device = *static_cast<opendmx::Device *>(context);
+    std::array<std::uint8_t, opendmx::universe_length> values;
+    for (long i = 0; i < iterations; i++) {
+        device.read(0, values);
+    }
+    sink = values[0];
+}
+
+// MARK: Direct Updates
+static void c_update_universe (void *context, long iterations) {
+    opendmx_device *device = static_cast<opendmx_device *>(context);
+    for (long i = 0; i < iterations; i++) {
+        uint8_t *slots = opendmx_begin_update(device);
+        memset(slots, (int)i, OPENDMX_UNIVERSE_LENGTH);
+        opendmx_end_update(device);
+    }
+}
+
+static void cpp_update_universe (void *context, long iterations) {
+    opendmx::Device &device = *static_cast<opendmx::Device *>(context);
+    for (long i = 0; i < iterations; i++) {
+        opendmx::Update update = device.update();
+        std::ranges::fill(update.slots(), (uint8_t)i);
+    }
+}
+
+static void c_update_fixtures (void *context, long iterations) {
+    opendmx_device *device = static_cast<opendmx_device *>(context);
+    for (long i = 0; i < iterations; i++) {
+        const uint8_t level = (uint8_t)i;
+        uint8_t *slots = opendmx_begin_update(device);
+        slots[0] = level; slots[1] = level; slots[2] = level; slots[3] = 0;
+        slots[100] = level; slots[101] = 0; slots[102] = 0; slots[103] = level;
+        slots[200] = 0; slots[201] = level; slots[202] = 0; slots[203] = level;
+        slots[508] = 0; slots[509] = 0; slots[510] = level; slots[511] = level;
+        opendmx_end_update(device);
+    }
+}
+
+static void cpp_update_fixtures (void *context, long iterations) {
+    opendmx::Device &device = *static_cast<opendmx::Device *>(context);
+    for (long i = 0; i < iterations; i++) {
+        const uint8_t level = (uint8_t)i;
+        opendmx::Update update = device.update();
+        std::ranges::copy(RGBW { level, level, level, 0 }, update[Fixture1()].begin());
+        std::ranges::copy(RGBW { level, 0, 0, level }, update[Fixture2()].begin());
+        std::ranges::copy(RGBW { 0, level, 0, level }, update[Fixture3()].begin());
+        Fixture4::channel<0>(update.slots()) = 0;
+        Fixture4::channel<1>(update.slots()) = 0;
+        Fixture4::channel<2>(update.slots()) = level;
+        Fixture4::channel<3>(update.slots()) = level;
+    }
+}
+
+// MARK: Device Enumeration
+// These compare the cost of the iterator wrappers over the virtual backend's fixed list, not of finding devices
+static void c_get_devices (void *context, long iterations) {
+    unsigned long count = 0;
+    for (long i = 0; i < iterations; i++) {
+        struct opendmx_iterator *devices = opendmx_get_devices();
+        while (opendmx_iterator_has_next(devices)) {
+            count += opendmx_iterator_next(devices)[0];
+        }
+        opendmx_iterator_free(devices);
+    }
+    sink = count;
+}
+
+static void cpp_device_list (void *context, long iterations) {
+    unsigned long count = 0;
+    for (long i = 0; i < iterations; i++) {
+        for (const char *name : opendmx::DeviceList::enumerate()) {
+            count += name[0];
+        }
+    }
+    sink = count;
+}
+
+static void run (const char *prefix, opendmx::Device &device) {
+    char name[64];
+    snprintf(name, sizeof(name), "%sc_update_universe", prefix);
+    bench(name, c_update_universe, device.get(), 1);
+    snprintf(name, sizeof(name), "%scpp_update_universe", prefix);
+    bench(name, cpp_update_universe, &device, 1);
+    snprintf(name, sizeof(name), "%sc_update_fixtures_4", prefix);
+    bench(name, c_update_fixtures, device.get(), 1);
+    snprintf(name, sizeof(name), "%scpp_update_fixtures_4", prefix);
+    bench(name, cpp_update_fixtures, &device, 1);
+}
+
+int main (int argc, char **argv) {
+    opendmx::Device device = opendmx::Device::open("virtual0");
+    if (!device) {
+        fprintf(stderr, "Failed to open virtual device\n");
+        return 1;
+    }
+
+    bench("c_set_slot", c_set_slot, device.get(), OPENDMX_UNIVERSE_LENGTH);
+    bench("cpp_set_slot", cpp_set_slot, &device, OPENDMX_UNIVERSE_LENGTH);
+    bench("c_set_slots_universe", c_set_slots, device.get(), 1);
+    bench("cpp_write_universe", cpp_write, &device, 1);
+    bench("c_get_slots_universe", c_get_slots, device.get(), 1);
+    bench("cpp_read_universe", cpp_read, &device, 1);
+    run("", device);
+
+    // Shared universes, written through a client attached to the segment
+    char name[64];
+    snprintf(name, sizeof(name), "/opendmx-bench-cpp-%d", (int)getpid());
+    if (device.share(name) == 0) {
+        opendmx::Device client = opendmx::Device::attach(name);
+        run("shared_", client);
+    } else {
+        fprintf(stderr, "Failed to share universe, skipping shared universe benchmarks\n");
+    }
+    device.close();
+
+    bench("c_get_devices", c_get_devices, NULL, 1);
+    bench("cpp_device_list", cpp_device_list, NULL, 1);
+    return 0;
+}
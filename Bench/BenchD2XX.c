@@ -0,0 +1,143 @@
+//
+//  BenchD2XX.c
+//  OpenDMX
+//
+//  Runs the D2XX backend against the stub in ftd2xx/ and reports how many D2XX calls are made when a device is opened
+//  and for each frame. Every call is a USB transaction on real hardware, so these counts bound the refresh rate and jitter.
+//  Device enumeration is also timed here, as it is the real FT_ListDevices path rather than the virtual backend's fixed list.
+//  Results are printed as one JSON object per line, like Bench.c. The counts are also checked against what the backend
+//  is meant to do, and the program exits non-zero if they differ.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "../OpenDMX.h"
+#include "ftd2xx.h"
+#include "Bench.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_FRAMES 20
+
+#define COUNT_FIELD(field) { #field, offsetof(struct ftd2xx_stub_counts, field) }
+
+static const struct {
+    const char  *name;
+    size_t      offset;
+} count_fields[] = {
+    COUNT_FIELD(open), COUNT_FIELD(close), COUNT_FIELD(list_devices), COUNT_FIELD(set_baud_rate),
+    COUNT_FIELD(set_data_characteristics), COUNT_FIELD(set_flow_control), COUNT_FIELD(clr_rts),
+    COUNT_FIELD(set_latency_timer), COUNT_FIELD(set_usb_parameters), COUNT_FIELD(purge), COUNT_FIELD(set_timeouts),
+    COUNT_FIELD(set_break_on), COUNT_FIELD(set_break_off), COUNT_FIELD(write), COUNT_FIELD(bytes_written)
+};
+
+#define NUM_COUNT_FIELDS ((int)(sizeof(count_fields) / sizeof(count_fields[0])))
+
+static unsigned long get_count (const struct ftd2xx_stub_counts *counts, int field) {
+    return *(const unsigned long *)((const char *)counts + count_fields[field].offset);
+}
+
+static void print_counts (const char *name, unsigned long divisor) {
+    printf("{\"benchmark\": \"%s\", \"count\": %lu", name, divisor);
+    for (int i = 0; i < NUM_COUNT_FIELDS; i++) {
+        printf(", \"%s\": %.2f", count_fields[i].name, get_count(&ftd2xx_stub_counts, i) / (double)divisor);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+static void bench_get_devices (void *context, long iterations) {
+    unsigned long count = 0;
+    for (long i = 0; i < iterations; i++) {
+        struct opendmx_iterator *devices = opendmx_get_devices();
+        while (opendmx_iterator_has_next(devices)) {
+            count += opendmx_iterator_next(devices)[0];
+        }
+        opendmx_iterator_free(devices);
+    }
+    sink = count;
+}
+
+/**
+ *  Check the calls made against the calls expected.
+ *  @param name The name of the measurement, used in error messages.
+ *  @param expected The calls expected for each repetition.
+ *  @param repetitions The number of times the measured operation was performed.
+ *  @returns 0 if every count matched, 1 otherwise.
+ */
+static int check_counts (const char *name, const struct ftd2xx_stub_counts *expected, unsigned long repetitions) {
+    int failed = 0;
+    for (int i = 0; i < NUM_COUNT_FIELDS; i++) {
+        const unsigned long actual = get_count(&ftd2xx_stub_counts, i);
+        if (actual != get_count(expected, i) * repetitions) {
+            fprintf(stderr, "%s: expected %lu calls to %s, got %lu\n", name, get_count(expected, i) * repetitions,
+                    count_fields[i].name, actual);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+int main (int argc, char **argv) {
+    ftd2xx_stub_reset();
+    opendmx_device *device = opendmx_open_device("STUB0");
+    if (device == NULL) {
+        fprintf(stderr, "Failed to open stub device\n");
+        return 1;
+    }
+    print_counts("d2xx_calls_per_open", 1);
+    // Everything is configured once when the device is opened
+    const struct ftd2xx_stub_counts per_open = {
+        .open = 1, .set_baud_rate = 1, .set_data_characteristics = 1, .set_flow_control = 1, .clr_rts = 1,
+        .set_latency_timer = 1, .set_usb_parameters = 1, .purge = 1, .set_timeouts = 1
+    };
+    int failed = check_counts("d2xx_calls_per_open", &per_open, 1);
+
+    // Run the output loop for a fixed number of frames
+    opendmx_interpacket_time = OPENDMX_PERIOD_HIGH;
+    ftd2xx_stub_reset();
+    pthread_t thread;
+    pthread_create(&thread, NULL, opendmx_thread, device);
+    while (!opendmx_is_running(device)) {
+        sched_yield();  // opendmx_wait_frame returns straight away until output has started
+    }
+    struct opendmx_frame_info frame = { 0, 0 };
+    while ((frame.sequence < BENCH_FRAMES) && (opendmx_wait_frame(device, 1000000000, &frame) == 0));
+    opendmx_stop(device);
+    pthread_join(thread, NULL);
+
+    struct opendmx_stats stats;
+    opendmx_get_stats(device, &stats);
+    print_counts("d2xx_calls_per_frame", stats.frames);
+    // Each frame is a break and a single write of the start code and the universe
+    const struct ftd2xx_stub_counts per_frame = {
+        .set_break_on = 1, .set_break_off = 1, .write = 1, .bytes_written = OPENDMX_UNIVERSE_LENGTH + 1
+    };
+    failed |= check_counts("d2xx_calls_per_frame", &per_frame, stats.frames);
+    if (stats.frames < BENCH_FRAMES) {
+        fprintf(stderr, "d2xx_calls_per_frame: only %lu frames were sent\n", stats.frames);
+        failed = 1;
+    }
+
+    opendmx_close_device(device);
+
+    // Enumeration asks for the number of devices and then for all of their serial numbers
+    ftd2xx_stub_reset();
+    struct opendmx_iterator *devices = opendmx_get_devices();
+    print_counts("d2xx_calls_per_enumeration", 1);
+    const struct ftd2xx_stub_counts per_enumeration = { .list_devices = 2 };
+    failed |= check_counts("d2xx_calls_per_enumeration", &per_enumeration, 1);
+    if ((devices == NULL) || (opendmx_iterator_length(devices) != ftd2xx_stub_num_devices)) {
+        fprintf(stderr, "d2xx_calls_per_enumeration: expected %d devices\n", ftd2xx_stub_num_devices);
+        failed = 1;
+    }
+    if (devices != NULL) {
+        opendmx_iterator_free(devices);
+    }
+    bench("get_devices_d2xx", bench_get_devices, NULL, 1);
+    return failed;
+}
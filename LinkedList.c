@@ -110,7 +110,7 @@ static char *list_unchain_node (struct list_node *node) {
 char *list_pop (struct list *list, const int index) {
     struct list_node *node = list_get_node(list, index);
     if (node == list->first) {
-        list->first = node->next;
+        list->first = (node->next != node) ? node->next : NULL;    // The list is empty once its only node is popped
     }
     list->length--;
     return list_unchain_node(node);
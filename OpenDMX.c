@@ -13,8 +13,28 @@
 
 #include <sys/ioctl.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <errno.h>
 
+// The D2XX backend is used unless another is chosen, OPENDMX_USE_SERIAL uses the operating system's serial port drivers instead
+#if !defined(OPENDMX_USE_VIRTUAL) && !defined(OPENDMX_USE_SERIAL)
 #define OPENDMX_USE_D2XX
+#endif
+
+#define OPENDMX_PACKET_LENGTH (OPENDMX_UNIVERSE_LENGTH + 1)
+#define OPENDMX_SHARED_MAGIC 0x444D5832   // "DMX2", marks an initialized shared universe
+#define OPENDMX_SNAPSHOT_TRIES 64
+#define OPENDMX_LATE_TOLERANCE 1000000     // A frame sent more than 1ms after it was due is counted as late
 
 #define OPENDMX_DATA_BAUD_RATE 250000
 #define OPENDMX_BREAK_BAUD_RATE 56000   // At 56kbaud this will hold the line low for 143µs (break) then high (the stop bits) for 36µs (MAB)
@@ -35,6 +55,7 @@
 #include <stdlib.h>
 
 #include <linux/serial.h>
+#include <sys/eventfd.h>
 
 #define SERIAL_PATH     "/sys/class/tty/*/device/driver"
 #define DEVICE_FORMAT   "/dev/%s"
@@ -50,27 +71,209 @@
 uint8_t opendmx_start_byte = 0;
 long opendmx_interpacket_time = OPENDMX_PERIOD_LOW;
 
+/**
+ *  Slot values for a universe. Shared universes live in a shared memory segment and may be written from several processes.
+ *  Writers hold write_lock while they update slots and generation is odd while they do. A reader's copy is consistent if the
+ *  generation was even and did not change while it was copying. The lock is robust, if a writer dies part way through an update
+ *  the next process to take the lock finishes the update for it.
+ */
+struct opendmx_universe {
+    uint32_t                magic;
+    volatile uint32_t       generation;
+    pthread_mutex_t         write_lock;     // Only used by shared universes
+    uint8_t                 slots[OPENDMX_UNIVERSE_LENGTH];
+};
+
 typedef struct opendmx_handle {
 #ifdef OPENDMX_USE_D2XX
     void                    *ftdi_handle;
-#else
+#elif defined(OPENDMX_USE_SERIAL)
     int                     device_handle;
 #endif
     volatile unsigned int   running:1;
     volatile unsigned int   error:1;
-    volatile unsigned int   lock:1;
-    uint8_t                 slots[OPENDMX_UNIVERSE_LENGTH];
+    unsigned int            shared:1;                           // The universe is in a shared memory segment
+    unsigned int            client:1;                           // The device only has access to a universe shared by another process
+    struct opendmx_universe *universe;                          // Either local_universe or a shared memory segment
+    struct opendmx_universe local_universe;
+    char                    *shared_name;                       // Name of the shared memory segment if this process created it
+    uint8_t                 packet[OPENDMX_PACKET_LENGTH];      // The outgoing packet, the start code followed by the frame
+    uint8_t                 *frame;                             // The outgoing frame (in packet), slots after the output stage has been applied
+    pthread_mutex_t         stage_lock;                         // Protects the output stage configuration
+    // Output stage response curves, curve 0 is the identity and is never applied
+    uint8_t                 slot_curves[OPENDMX_UNIVERSE_LENGTH];   // The curve used by each slot
+    uint8_t                 curves[OPENDMX_MAX_CURVES + 1][256];
+    uint16_t                curve_slots[OPENDMX_UNIVERSE_LENGTH];   // Slots which use a curve, grouped by curve
+    uint16_t                curve_group_end[OPENDMX_MAX_CURVES + 1];// End of each curve's group in curve_slots
+    struct list             effects;                            // Active effects, each entry is an opendmx_effect_handle
+    opendmx_frame_hook      frame_hook;
+    void                    *frame_hook_context;
+    volatile long           frame_hook_lead_time;               // Time before a frame is due that it is built and the hook is called
+    pthread_cond_t          frame_hook_done;                    // Signaled when the frame hook returns
+    int                     frame_hook_running;                 // Set while the frame hook is being called, protected by stage_lock
+    pthread_t               frame_hook_thread;                  // The thread calling the frame hook, valid while frame_hook_running is set
+    struct opendmx_stats    stats;
+    // Frame notifications, signaled by the output loop after each frame is sent and when output starts or stops
+    pthread_mutex_t         frame_lock;
+    pthread_cond_t          frame_sent;
+    struct opendmx_handle   *output_owner;                      // The device whose output loop is running on this device, protected by frame_lock
+    struct opendmx_frame_info last_frame;
+    int                     frame_fd;                           // eventfd written after each frame, -1 until requested
+    // Scheduled changes, a binary min-heap ordered by time, protected by stage_lock
+    struct scheduled_change *schedule;
+    int                     schedule_length;
+    int                     schedule_capacity;
+    uint64_t                schedule_order;
 } opendmx_device;
 
+struct scheduled_change {
+    uint64_t                time;       // CLOCK_MONOTONIC time at which the change should be applied in nanoseconds
+    uint64_t                order;      // Keeps changes scheduled for the same time in the order they were scheduled
+    int                     first_slot;
+    int                     count;
+    uint8_t                 *values;
+};
+
+typedef struct opendmx_effect_handle {
+    struct opendmx_effect   effect;     // A copy of the parameters, fixed once the effect is added
+    uint64_t                start;      // Time at which the effect was added in nanoseconds
+    uint8_t                 waveform[256];  // One cycle of the waveform, scaled to the effect's range
+} opendmx_effect_handle;
+
+/**
+ *  Sender threads for an output loop with more than one port, so that a port which stalls can't hold up the others.
+ */
+struct output_senders {
+    pthread_mutex_t         lock;
+    pthread_cond_t          wake;       // Signaled when there is a new packet to send or the senders should stop
+    pthread_cond_t          done;       // Signaled when a sender finishes sending a packet
+    uint64_t                sequence;   // Sequence number of the most recent packet handed to the senders
+    int                     stopping;
+};
+
+struct output_port {
+    opendmx_device          *device;
+    uint8_t                 errors;     // Tracks the number of frames which have failed to send
+    volatile int            failed;     // Set once 8 frames in a row have failed, the port is no longer used
+    // Sender thread state, protected by the senders' lock
+    struct output_senders   *senders;
+    pthread_t               thread;
+    uint64_t                queued;     // Sequence number of the packet given to the sender
+    uint64_t                sent;       // Sequence number of the last packet the sender finished with
+    int                     result;     // Result of send_packet for that packet
+    uint8_t                 packet[OPENDMX_PACKET_LENGTH];  // The port's own copy, a stalled send can carry on while the next frame is built
+};
+
+typedef struct opendmx_group_handle {
+    int                     num_ports;
+    struct output_port      ports[];
+} opendmx_group;
+
 struct opendmx_iterator {
     struct list             *list;
     struct list_iterator    *iterator;
 };
 
-static int send_packet (opendmx_device *device);
+enum input_state {
+    INPUT_WAIT_BREAK,       // Waiting for a break before accepting data
+    INPUT_START_CODE,       // A break has been received, the next byte is the start code
+    INPUT_SLOTS             // Receiving slots
+};
+
+typedef struct opendmx_input_handle {
+    int                         port;           // File descriptor for the serial port, -1 if bytes are only fed in by the application
+    // Input loop state, protected by lock
+    pthread_mutex_t             lock;
+    pthread_cond_t              stopped;        // Signaled when the input loop exits
+    int                         running;        // Cleared to ask the input loop to stop
+    int                         active;         // Set while the input loop is running, it must not be freed until this is clear
+    int                         error;
+    // Parser
+    enum input_state            state;
+    int                         marks;          // Number of bytes of a PARMRK sequence (0xFF 0x00) which have been received
+    struct opendmx_input_frame  staging;        // The frame being received
+    // Ring of received frames, written only by the parser and read only by opendmx_input_read_frame
+    volatile uint32_t           head;           // Number of frames which have been written
+    volatile uint32_t           tail;           // Number of frames which have been read
+    struct opendmx_input_frame  ring[OPENDMX_INPUT_RING_LENGTH];
+    // Statistics
+    struct opendmx_input_stats  stats;
+    uint64_t                    window_start;   // Start of the window over which the frame rate is being measured
+    unsigned long               window_frames;
+} opendmx_input;
+
+static int send_packet (opendmx_device *device, const uint8_t *packet);
 static int close_output (const opendmx_device *device);
+static int open_input_port (opendmx_input *input, const char *port_name);
+static int read_input_port (opendmx_input *input, uint8_t *buffer, int length);
+static void close_input_port (opendmx_input *input);
 
-# ifndef OPENDMX_USE_D2XX
+static void init_device (opendmx_device *device) {
+    // Initialize universe
+    for (int i = 0; i < OPENDMX_UNIVERSE_LENGTH; i++) {
+        device->local_universe.slots[i] = 0;
+        device->slot_curves[i] = 0;
+    }
+    device->local_universe.magic = 0;
+    device->local_universe.generation = 0;
+    device->universe = &device->local_universe;
+    device->frame = device->packet + 1;
+    device->shared = 0;
+    device->client = 0;
+    device->shared_name = NULL;
+    for (int i = 0; i <= OPENDMX_MAX_CURVES; i++) {
+        device->curve_group_end[i] = 0;
+    }
+    pthread_mutex_init(&device->stage_lock, NULL);
+    device->effects.first = NULL;
+    device->effects.length = 0;
+    device->frame_hook = NULL;
+    device->frame_hook_context = NULL;
+    device->frame_hook_lead_time = 0;
+    pthread_cond_init(&device->frame_hook_done, NULL);
+    device->frame_hook_running = 0;
+    memset(&device->stats, 0, sizeof(device->stats));
+    
+    pthread_mutex_init(&device->frame_lock, NULL);
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+#ifndef __APPLE__
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);  // Timeouts for opendmx_wait_frame are measured on the same clock as frames
+#endif
+    pthread_cond_init(&device->frame_sent, &attributes);
+    pthread_condattr_destroy(&attributes);
+    device->last_frame.sequence = 0;
+    device->last_frame.timestamp = 0;
+    device->frame_fd = -1;
+    device->output_owner = NULL;
+    device->schedule = NULL;
+    device->schedule_length = 0;
+    device->schedule_capacity = 0;
+    device->schedule_order = 0;
+}
+
+static void deinit_device (opendmx_device *device) {
+    pthread_mutex_destroy(&device->stage_lock);
+    pthread_cond_destroy(&device->frame_hook_done);
+    pthread_mutex_destroy(&device->frame_lock);
+    pthread_cond_destroy(&device->frame_sent);
+    if (device->frame_fd != -1) {
+        close(device->frame_fd);
+    }
+    list_free(&device->effects);
+    for (int i = 0; i < device->schedule_length; i++) {
+        free(device->schedule[i].values);
+    }
+    free(device->schedule);
+}
+
+static uint64_t monotonic_time (void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#ifdef OPENDMX_USE_SERIAL
 opendmx_device *opendmx_open_device (const char *port_name) {
     struct opendmx_handle *device = malloc(sizeof(*device));
     
@@ -129,12 +332,7 @@ opendmx_device *opendmx_open_device (const char *port_name) {
         goto error;     // failed to set settings
     }
     
-    // Initialize universe
-    for (int i = 0; i < OPENDMX_UNIVERSE_LENGTH; i++) {
-        device->slots[i] = 0;
-    }
-    
-    device->lock = 0;
+    init_device(device);
     
     // It worked!
     return device;
@@ -166,7 +364,7 @@ static int set_baud_rate (const int device, const int speed) {
     ser.flags &= ~ASYNC_SPD_MASK;
     ser.flags |= ASYNC_SPD_CUST;
     
-    if (ioctl (device, TIOCSSERIAL, ser) < 0) {
+    if (ioctl (device, TIOCSSERIAL, &ser) < 0) {
         return 1;
     }
     return 0;
@@ -175,13 +373,12 @@ static int set_baud_rate (const int device, const int speed) {
 #endif
 }
 
-static int send_packet (const opendmx_device *device) {
+static int send_packet (opendmx_device *device, const uint8_t *packet) {
     const int break_byte = 0; // Need to define this as a constant so I that can get a pointer to it
     int error = set_baud_rate(device->device_handle, OPENDMX_BREAK_BAUD_RATE);         // Drop to lower baud rate
     error = error || (write(device->device_handle, &break_byte, 1) != 1); // transmit a zero
     error = error || set_baud_rate(device->device_handle, OPENDMX_DATA_BAUD_RATE);        // Return to the proper baud rate
-    error = error || (write(device->device_handle, &opendmx_start_byte, 1)  != 1); // send the start code
-    error = error || (write(device->device_handle, device->slots, OPENDMX_UNIVERSE_LENGTH) != OPENDMX_UNIVERSE_LENGTH);// send the DMX slots
+    error = error || (write(device->device_handle, packet, OPENDMX_PACKET_LENGTH) != OPENDMX_PACKET_LENGTH); // send the start code and the DMX slots
     return error;
 }
 
@@ -189,63 +386,1078 @@ static int close_output (const opendmx_device *device) {
     return (close(device->device_handle) != 0);
 }
 
-#endif  //  not OPENDMX_USE_D2XX
+static int open_input_port (opendmx_input *input, const char *port_name) {
+    input->port = open(port_name, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (input->port == -1) {
+        return -1;
+    }
+    if ((ioctl(input->port, TIOCEXCL) != 0) || (fcntl(input->port, F_SETFL, 0) != 0)) {
+        goto error;
+    }
+    
+    struct termios settings;
+    if (tcgetattr(input->port, &settings) != 0) {
+        goto error;
+    }
+    // cflag (8N2, receiver enabled)
+    settings.c_cflag &= ~(PARENB | CSIZE);
+    settings.c_cflag |= CS8 | CSTOPB | CLOCAL | CREAD;
+    // oflag and lflag (disable output and line processing)
+    settings.c_oflag &= ~OPOST;
+    settings.c_lflag &= ~(ECHO | ECHONL | ICANON | IEXTEN | ISIG);
+    // iflag (report breaks and framing errors in the data as 0xFF 0x00 0x00, a data byte of 0xFF is sent as 0xFF 0xFF)
+    settings.c_iflag &= ~(IGNBRK | BRKINT | IGNPAR | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+    settings.c_iflag |= PARMRK | INPCK;
+    // Return from reads after 100ms without data so that the input loop can check if it has been stopped
+    settings.c_cc[VMIN] = 0;
+    settings.c_cc[VTIME] = 1;
+#ifdef __linux__
+    // The custom divisor set by set_baud_rate is only used at 38400 baud
+    cfsetispeed(&settings, B38400);
+    cfsetospeed(&settings, B38400);
+#endif
+    
+    tcflush(input->port, TCIFLUSH);
+    if (tcsetattr(input->port, TCSANOW, &settings) != 0) {
+        goto error;
+    }
+    if (set_baud_rate(input->port, OPENDMX_DATA_BAUD_RATE) != 0) {
+        goto error;
+    }
+    return 0;
+    
+error:
+    close(input->port);
+    input->port = -1;
+    return -1;
+}
+
+static int read_input_port (opendmx_input *input, uint8_t *buffer, int length) {
+    ssize_t count;
+    do {
+        count = read(input->port, buffer, length);
+    } while ((count < 0) && (errno == EINTR));
+    
+#ifdef __linux__
+    // Line error counts from the driver, these include errors which happened while the buffer was full
+    struct serial_icounter_struct counts;
+    if (ioctl(input->port, TIOCGICOUNT, &counts) == 0) {
+        input->stats.line_breaks = counts.brk;
+        input->stats.line_framing_errors = counts.frame;
+        input->stats.line_overruns = counts.overrun + counts.buf_overrun;
+    }
+#endif
+    return (int)count;
+}
+
+static void close_input_port (opendmx_input *input) {
+    close(input->port);
+}
+
+#endif  //  OPENDMX_USE_SERIAL
+
+// MARK: Output Stage
+static void apply_curves (const opendmx_device *device, uint8_t *frame) {
+    // Slots are grouped by curve so that each table stays hot in the cache while it is used, slots without a curve are never visited
+    int start = 0;
+    for (int c = 1; c <= OPENDMX_MAX_CURVES; c++) {
+        const uint8_t *curve = device->curves[c];
+        const int end = device->curve_group_end[c];
+        for (int i = start; i < end; i++) {
+            const int slot = device->curve_slots[i];
+            frame[slot] = curve[frame[slot]];
+        }
+        start = end;
+    }
+}
+
+static void render_waveform (opendmx_effect_handle *state) {
+    // Waveforms are rendered into a table once so that evaluating an effect is a single lookup per slot
+    const struct opendmx_effect *effect = &state->effect;
+    const int range = effect->high - effect->low;
+    for (int i = 0; i < 256; i++) {
+        int value = 0;  // 0 to 255
+        switch (effect->waveform) {
+            case OPENDMX_WAVE_SINE:
+                value = (int)lround(127.5 - 127.5 * cos(i * M_PI / 128));  // Starts at zero like the other waveforms
+                break;
+            case OPENDMX_WAVE_TRIANGLE:
+                value = (i < 128) ? i * 2 : (255 - i) * 2 + 1;
+                break;
+            case OPENDMX_WAVE_SAW:
+                value = i;
+                break;
+            case OPENDMX_WAVE_SQUARE:
+                value = ((i << 8) < effect->duty) ? 255 : 0;
+                break;
+        }
+        // x * 257 >> 16 is x / 255 in fixed point
+        state->waveform[i] = effect->low + ((range * value * 257 + 32768) >> 16);
+    }
+}
+
+static void apply_effect (const opendmx_effect_handle *state, uint8_t *universe, uint64_t timestamp) {
+    const struct opendmx_effect *effect = &state->effect;
+    const int count = effect->count;
+    uint8_t *frame = universe + effect->first_slot;
+    uint8_t values[OPENDMX_UNIVERSE_LENGTH];
+    
+    // Position in the cycle, 65536 is a full cycle
+    const uint64_t elapsed = (timestamp > state->start) ? timestamp - state->start : 0;
+    const uint16_t phase = (uint16_t)((((elapsed % effect->period) << 16) / effect->period) + effect->phase);
+    const uint16_t step = effect->phase_step;
+    
+    uint16_t p = phase;
+    for (int i = 0; i < count; i++, p += step) {
+        values[i] = state->waveform[p >> 8];
+    }
+    
+    // Compose with the universe, these loops are kept branch free so that they can be vectorized
+    switch (effect->compose) {
+        case OPENDMX_COMPOSE_REPLACE:
+            memcpy(frame, values, count);
+            break;
+        case OPENDMX_COMPOSE_ADD:
+            for (int i = 0; i < count; i++) {
+                const int sum = frame[i] + values[i];
+                frame[i] = (sum > 255) ? 255 : sum;
+            }
+            break;
+        case OPENDMX_COMPOSE_MAX:
+            for (int i = 0; i < count; i++) {
+                frame[i] = (values[i] > frame[i]) ? values[i] : frame[i];
+            }
+            break;
+    }
+}
+
+static void apply_effects (const opendmx_device *device, uint8_t *frame, uint64_t timestamp) {
+    struct list_node *node = device->effects.first;
+    for (int i = 0; i < device->effects.length; i++, node = node->next) {
+        apply_effect((const opendmx_effect_handle *)node->value, frame, timestamp);
+    }
+}
+
+// MARK: Universe Access
+/**
+ *  Take the write lock of a shared universe.
+ *  @returns 0 if the lock was taken, EOWNERDEAD if it was taken from a writer which died holding it, or another error number.
+ */
+static int lock_universe (struct opendmx_universe *universe, int blocking) {
+    const int result = blocking ? pthread_mutex_lock(&universe->write_lock) : pthread_mutex_trylock(&universe->write_lock);
+#ifndef __APPLE__
+    if (result == EOWNERDEAD) {
+        // The writer's update was cut short, whatever it wrote stays and its generation is ended on its behalf
+        pthread_mutex_consistent(&universe->write_lock);
+        if (__atomic_load_n(&universe->generation, __ATOMIC_RELAXED) & 1) {
+            __atomic_fetch_add(&universe->generation, 1, __ATOMIC_RELEASE);
+        }
+    }
+#endif
+    return result;
+}
+
+static void begin_write (opendmx_device *device) {
+    if (device->shared) {
+        lock_universe(device->universe, 1);
+        __atomic_fetch_add(&device->universe->generation, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);    // Readers see the odd generation before any of the slots change
+    }
+}
+
+static void end_write (opendmx_device *device) {
+    if (device->shared) {
+        __atomic_fetch_add(&device->universe->generation, 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&device->universe->write_lock);
+    }
+}
+
+/**
+ *  Copy the slots of a universe.
+ *  @returns 0 if the copy is consistent, < 0 if it may have been made part way through an update.
+ */
+static int read_universe (const opendmx_device *device, uint8_t *buffer) {
+    struct opendmx_universe *universe = device->universe;
+    if (!device->shared) {
+        memcpy(buffer, universe->slots, OPENDMX_UNIVERSE_LENGTH);
+        return 0;
+    }
+    for (int i = 0; i < OPENDMX_SNAPSHOT_TRIES; i++) {
+        const uint32_t generation = __atomic_load_n(&universe->generation, __ATOMIC_ACQUIRE);
+        if ((generation & 1) == 0) {
+            memcpy(buffer, universe->slots, OPENDMX_UNIVERSE_LENGTH);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&universe->generation, __ATOMIC_RELAXED) == generation) {
+                return 0;
+            }
+        }
+        sched_yield();
+    }
+    // Either a writer is holding the lock for a long time or it died while holding it, which is recovered by taking the lock
+    const int locked = lock_universe(universe, 0);
+    memcpy(buffer, universe->slots, OPENDMX_UNIVERSE_LENGTH);
+    if ((locked == 0) || (locked == EOWNERDEAD)) {
+        pthread_mutex_unlock(&universe->write_lock);
+        return 0;
+    }
+    // The writer is still running, settle for a copy which may be mid-update rather than missing the frame
+    return -1;
+}
+
+/**
+ *  @returns 0 if the frame was built from a consistent copy of the universe, < 0 if the copy may have been made mid-update.
+ */
+static int assemble_frame (opendmx_device *device, uint8_t *frame, uint64_t timestamp) {
+    pthread_mutex_lock(&device->stage_lock);
+    const int result = read_universe(device, frame);
+    apply_effects(device, frame, timestamp);
+    pthread_mutex_unlock(&device->stage_lock);
+    return result;
+}
+
+static void finish_frame (opendmx_device *device, uint8_t *frame) {
+    pthread_mutex_lock(&device->stage_lock);
+    apply_curves(device, frame);
+    pthread_mutex_unlock(&device->stage_lock);
+}
+
+void opendmx_render_frame (opendmx_device *device, uint8_t *buffer) {
+    assemble_frame(device, buffer, monotonic_time());
+    finish_frame(device, buffer);
+}
+
+/**
+ *  Sleep on the output thread until a time, or until output is stopped.
+ */
+static void sleep_until (opendmx_device *device, uint64_t time) {
+    pthread_mutex_lock(&device->frame_lock);
+    while (device->running) {
+        const uint64_t now = monotonic_time();
+        if (now >= time) break;
+#ifdef __APPLE__
+        struct timespec wait_time = { (time - now) / 1000000000, (time - now) % 1000000000 };
+        pthread_cond_timedwait_relative_np(&device->frame_sent, &device->frame_lock, &wait_time);
+#else
+        struct timespec wait_time = { time / 1000000000, time % 1000000000 };
+        pthread_cond_timedwait(&device->frame_sent, &device->frame_lock, &wait_time);
+#endif
+    }
+    pthread_mutex_unlock(&device->frame_lock);
+}
+
+static void run_frame_hook (opendmx_device *device, uint64_t deadline) {
+    pthread_mutex_lock(&device->stage_lock);
+    const opendmx_frame_hook hook = device->frame_hook;
+    void *context = device->frame_hook_context;
+    if (hook == NULL) {
+        pthread_mutex_unlock(&device->stage_lock);
+        return;
+    }
+    // The hook is called without the lock held so that it can change the output stage, opendmx_set_frame_hook waits for it
+    device->frame_hook_running = 1;
+    device->frame_hook_thread = pthread_self();
+    pthread_mutex_unlock(&device->stage_lock);
+    
+    const uint64_t start = monotonic_time();
+    hook(device, device->frame, deadline, context);
+    const uint64_t hook_time = monotonic_time() - start;
+    
+    pthread_mutex_lock(&device->stage_lock);
+    device->frame_hook_running = 0;
+    pthread_cond_broadcast(&device->frame_hook_done);
+    pthread_mutex_unlock(&device->stage_lock);
+    
+    device->stats.hook_time_last = hook_time;
+    device->stats.hook_time_total += hook_time;
+    if (hook_time > device->stats.hook_time_max) {
+        device->stats.hook_time_max = hook_time;
+    }
+}
 
 void *opendmx_thread (void *device) {
     opendmx_start((opendmx_device*) device);    // Start the DMX device
     return NULL;
 }
 
-int opendmx_start (opendmx_device *device) {
+// MARK: Scheduled Changes
+static int change_before (const struct scheduled_change *a, const struct scheduled_change *b) {
+    return (a->time < b->time) || ((a->time == b->time) && (a->order < b->order));
+}
+
+static void schedule_sift_up (struct scheduled_change *heap, int index) {
+    const struct scheduled_change change = heap[index];
+    while (index > 0) {
+        const int parent = (index - 1) / 2;
+        if (!change_before(&change, &heap[parent])) break;
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = change;
+}
+
+static void schedule_sift_down (struct scheduled_change *heap, int length, int index) {
+    const struct scheduled_change change = heap[index];
+    for (;;) {
+        int child = index * 2 + 1;
+        if (child >= length) break;
+        if ((child + 1 < length) && change_before(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (!change_before(&heap[child], &change)) break;
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = change;
+}
+
+static void apply_schedule (opendmx_device *device, uint64_t deadline) {
+    pthread_mutex_lock(&device->stage_lock);
+    if ((device->schedule_length > 0) && (device->schedule[0].time <= deadline)) {
+        // All of the changes due by this frame are written as a single update
+        begin_write(device);
+        while ((device->schedule_length > 0) && (device->schedule[0].time <= deadline)) {
+            struct scheduled_change *change = &device->schedule[0];
+            memcpy(device->universe->slots + change->first_slot, change->values, change->count);
+            free(change->values);
+            device->schedule_length--;
+            if (device->schedule_length > 0) {
+                device->schedule[0] = device->schedule[device->schedule_length];
+                schedule_sift_down(device->schedule, device->schedule_length, 0);
+            }
+        }
+        end_write(device);
+    }
+    pthread_mutex_unlock(&device->stage_lock);
+}
+
+int opendmx_schedule_slots (opendmx_device *device, uint64_t time, int first_slot, const uint8_t *values, int count) {
+    if (device->client) {
+        return -1;  // Only the output loop applies scheduled changes, and it runs in the process which owns the universe
+    }
+    if ((0 > first_slot) || (0 > count) || (first_slot + count > OPENDMX_UNIVERSE_LENGTH)) {
+        return -1;
+    }
+    uint8_t *copy = malloc(count > 0 ? count : 1);
+    if (copy == NULL) {
+        return -1;
+    }
+    memcpy(copy, values, count);
+    
+    pthread_mutex_lock(&device->stage_lock);
+    if (device->schedule_length == device->schedule_capacity) {
+        const int capacity = (device->schedule_capacity > 0) ? device->schedule_capacity * 2 : 64;
+        struct scheduled_change *schedule = realloc(device->schedule, capacity * sizeof(*schedule));
+        if (schedule == NULL) {
+            pthread_mutex_unlock(&device->stage_lock);
+            free(copy);
+            return -1;
+        }
+        device->schedule = schedule;
+        device->schedule_capacity = capacity;
+    }
+    struct scheduled_change *change = &device->schedule[device->schedule_length];
+    change->time = time;
+    change->order = device->schedule_order++;
+    change->first_slot = first_slot;
+    change->count = count;
+    change->values = copy;
+    schedule_sift_up(device->schedule, device->schedule_length++);
+    pthread_mutex_unlock(&device->stage_lock);
+    return 0;
+}
+
+void opendmx_clear_schedule (opendmx_device *device) {
+    pthread_mutex_lock(&device->stage_lock);
+    for (int i = 0; i < device->schedule_length; i++) {
+        free(device->schedule[i].values);
+    }
+    device->schedule_length = 0;
+    pthread_mutex_unlock(&device->stage_lock);
+}
+
+// MARK: Frame Notifications
+static void signal_frame (opendmx_device *device, uint64_t timestamp) {
+    pthread_mutex_lock(&device->frame_lock);
+    device->last_frame.sequence++;
+    device->last_frame.timestamp = timestamp;
+    pthread_cond_broadcast(&device->frame_sent);
+    const int fd = device->frame_fd;
+    pthread_mutex_unlock(&device->frame_lock);
+#ifdef __linux__
+    if (fd != -1) {
+        const uint64_t frames = 1;
+        if (write(fd, &frames, sizeof(frames)) != sizeof(frames)) {
+            // The counter is saturated because nobody is reading it, the fd stays readable so there is nothing to do
+        }
+    }
+#endif
+}
+
+static void release_ports (struct output_port *ports, int num_ports) {
+    for (int i = 0; i < num_ports; i++) {
+        opendmx_device *port = ports[i].device;
+        pthread_mutex_lock(&port->frame_lock);
+        port->output_owner = NULL;
+        pthread_mutex_unlock(&port->frame_lock);
+    }
+}
+
+static void signal_stopped (opendmx_device *device, int error) {
+    // Wake any waiters so that they can see that no more frames are coming, the device must not be touched after this as it may be closed
+    pthread_mutex_lock(&device->frame_lock);
+    device->running = 0;
+    device->error = error;
+    device->output_owner = NULL;
+    pthread_cond_broadcast(&device->frame_sent);
+    pthread_mutex_unlock(&device->frame_lock);
+}
+
+/**
+ *  Mark the devices in ports as in use by device's output loop, so that they can't be closed or used by another loop.
+ *  @returns 0 if successful, -1 if output is already running on one of the ports.
+ */
+static int claim_ports (opendmx_device *device, struct output_port *ports, int num_ports) {
+    for (int i = 0; i < num_ports; i++) {
+        opendmx_device *port = ports[i].device;
+        pthread_mutex_lock(&port->frame_lock);
+        const int busy = port->output_owner != NULL;
+        if (!busy) {
+            port->output_owner = device;
+        }
+        pthread_mutex_unlock(&port->frame_lock);
+        if (busy) {
+            release_ports(ports, i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void wait_output_stopped (opendmx_device *device) {
+    pthread_mutex_lock(&device->frame_lock);
+    while (device->output_owner == device) {
+        pthread_cond_wait(&device->frame_sent, &device->frame_lock);
+    }
+    pthread_mutex_unlock(&device->frame_lock);
+}
+
+int opendmx_wait_frame (opendmx_device *device, long timeout, struct opendmx_frame_info *info) {
+    int result = 0;
+    pthread_mutex_lock(&device->frame_lock);
+    const uint64_t sequence = device->last_frame.sequence;
+    const uint64_t end = monotonic_time() + timeout;
+    while (device->last_frame.sequence == sequence) {
+        if (!device->running) {
+            result = -1;    // Output stopped, or was never started, so no frame is coming
+            break;
+        }
+        if (timeout < 0) {
+            pthread_cond_wait(&device->frame_sent, &device->frame_lock);
+            continue;
+        }
+#ifdef __APPLE__
+        // The wait is relative, so work out how much of the timeout is left after any earlier wakeups
+        const uint64_t now = monotonic_time();
+        if (now >= end) {
+            result = -1;
+            break;
+        }
+        struct timespec wait_time = { (end - now) / 1000000000, (end - now) % 1000000000 };
+        pthread_cond_timedwait_relative_np(&device->frame_sent, &device->frame_lock, &wait_time);
+#else
+        struct timespec wait_time = { end / 1000000000, end % 1000000000 };
+        if ((pthread_cond_timedwait(&device->frame_sent, &device->frame_lock, &wait_time) != 0) &&
+            (device->last_frame.sequence == sequence)) {
+            result = -1;    // Timed out
+            break;
+        }
+#endif
+    }
+    if ((result == 0) && (info != NULL)) {
+        *info = device->last_frame;
+    }
+    pthread_mutex_unlock(&device->frame_lock);
+    return result;
+}
+
+int opendmx_frame_fd (opendmx_device *device) {
+#ifdef __linux__
+    pthread_mutex_lock(&device->frame_lock);
+    if (device->frame_fd == -1) {
+        device->frame_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    const int fd = device->frame_fd;
+    pthread_mutex_unlock(&device->frame_lock);
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+// MARK: Output Ports
+static void *run_sender (void *context) {
+    struct output_port *port = context;
+    struct output_senders *senders = port->senders;
+    pthread_mutex_lock(&senders->lock);
+    while (1) {
+        while (!senders->stopping && (port->sent == port->queued)) {
+            pthread_cond_wait(&senders->wake, &senders->lock);
+        }
+        if (senders->stopping) break;
+        const uint64_t sequence = port->queued;
+        pthread_mutex_unlock(&senders->lock);
+        const int failed = send_packet(port->device, port->packet);
+        pthread_mutex_lock(&senders->lock);
+        port->result = failed;
+        port->sent = sequence;
+        pthread_cond_broadcast(&senders->done);
+    }
+    pthread_mutex_unlock(&senders->lock);
+    return NULL;
+}
+
+static void stop_senders (struct output_senders *senders, struct output_port *ports, int num_ports) {
+    pthread_mutex_lock(&senders->lock);
+    senders->stopping = 1;
+    pthread_cond_broadcast(&senders->wake);
+    pthread_mutex_unlock(&senders->lock);
+    // A sender which is stalled finishes its send first, this is bounded by the backend's write timeout
+    for (int i = 0; i < num_ports; i++) {
+        pthread_join(ports[i].thread, NULL);
+    }
+    pthread_mutex_destroy(&senders->lock);
+    pthread_cond_destroy(&senders->wake);
+    pthread_cond_destroy(&senders->done);
+}
+
+static int start_senders (struct output_senders *senders, struct output_port *ports, int num_ports) {
+    pthread_mutex_init(&senders->lock, NULL);
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+#ifndef __APPLE__
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);  // Sends are timed against the frame deadline
+#endif
+    pthread_cond_init(&senders->wake, NULL);
+    pthread_cond_init(&senders->done, &attributes);
+    pthread_condattr_destroy(&attributes);
+    senders->sequence = 0;
+    senders->stopping = 0;
+    for (int i = 0; i < num_ports; i++) {
+        ports[i].senders = senders;
+        ports[i].queued = 0;
+        ports[i].sent = 0;
+        if (pthread_create(&ports[i].thread, NULL, run_sender, &ports[i]) != 0) {
+            stop_senders(senders, ports, i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Hand a packet to every port's sender and wait for them to finish, or until the packet should have been transmitted.
+ *  A port which is still busy with an earlier packet, or which doesn't finish in time, is counted as having failed.
+ */
+static void send_parallel (struct output_senders *senders, struct output_port *ports, int num_ports, const uint8_t *packet,
+                           uint64_t timeout) {
+    pthread_mutex_lock(&senders->lock);
+    const uint64_t sequence = ++senders->sequence;
+    for (int i = 0; i < num_ports; i++) {
+        if (ports[i].failed || (ports[i].sent != ports[i].queued)) continue;
+        memcpy(ports[i].packet, packet, OPENDMX_PACKET_LENGTH);
+        ports[i].queued = sequence;
+    }
+    pthread_cond_broadcast(&senders->wake);
+    for (int i = 0; i < num_ports; i++) {
+        while ((ports[i].queued == sequence) && (ports[i].sent != sequence)) {
+            const uint64_t now = monotonic_time();
+            if (now >= timeout) break;
+#ifdef __APPLE__
+            struct timespec wait_time = { (timeout - now) / 1000000000, (timeout - now) % 1000000000 };
+            pthread_cond_timedwait_relative_np(&senders->done, &senders->lock, &wait_time);
+#else
+            struct timespec wait_time = { timeout / 1000000000, timeout % 1000000000 };
+            pthread_cond_timedwait(&senders->done, &senders->lock, &wait_time);
+#endif
+        }
+    }
+    for (int i = 0; i < num_ports; i++) {
+        const int done = (ports[i].queued == sequence) && (ports[i].sent == sequence);
+        ports[i].result = done ? ports[i].result : 1;
+    }
+    pthread_mutex_unlock(&senders->lock);
+}
+
+/**
+ *  The output loop. Frames are built from device, which provides the universe, output stage, timing, statistics and
+ *  notifications, and the same packet is sent on each of the ports. Output continues as long as at least one port works.
+ */
+static int run_output (opendmx_device *device, struct output_port *ports, int num_ports) {
+    if (claim_ports(device, ports, num_ports) != 0) {
+        return -1;  // Output is already running on one of the ports
+    }
+    // With more than one port each is sent on from its own thread, a single port is sent on directly
+    struct output_senders senders;
+    if ((num_ports > 1) && (start_senders(&senders, ports, num_ports) != 0)) {
+        release_ports(ports + 1, num_ports - 1);
+        signal_stopped(device, 1);
+        return -1;
+    }
+    pthread_mutex_lock(&device->frame_lock);
     device->running = 1;
     device->error = 0;
-    uint8_t errors = 0; // Tracks the number of frames which have failed to send
+    pthread_mutex_unlock(&device->frame_lock);
+    for (int i = 0; i < num_ports; i++) {
+        ports[i].errors = 0;
+        ports[i].failed = 0;
+    }
+    int live_ports = num_ports;
+    uint64_t deadline = monotonic_time();   // Time at which the next frame should be sent
     while (device->running) {   // Run as along as the device hasn't been told not to
-        int lock_status = device->lock;
-        device->lock = 1;
-        errors = (errors << 1) | (send_packet(device) ? 1 : 0);
-        if ((errors & 0xFF) == 0xFF) {
-            // If 8 errors have occured in a row, stop DMX output and register an error. This usually means that the DMX output device has been disconected.
-            device->running = 0;
-            device->error = 1;
-            device->lock = lock_status;
+        // Build the frame as late as possible, leaving enough time for the frame hook to run before it is due
+        sleep_until(device, deadline - device->frame_hook_lead_time);
+        if (!device->running) break;
+        apply_schedule(device, deadline);
+        if (assemble_frame(device, device->frame, deadline) != 0) {
+            device->stats.torn_frames++;
+        }
+        run_frame_hook(device, deadline);
+        finish_frame(device, device->frame);
+        device->packet[0] = opendmx_start_byte;
+        sleep_until(device, deadline);
+        if (!device->running) break;
+        
+        const uint64_t now = monotonic_time();
+        if (now > deadline + OPENDMX_LATE_TOLERANCE) {
+            device->stats.late_frames++;
+        }
+        int sent = 0;
+        if (num_ports > 1) {
+            send_parallel(&senders, ports, num_ports, device->packet, deadline + OPENDMX_PACKET_TIME);
+        } else {
+            ports[0].result = send_packet(ports[0].device, device->packet);
+        }
+        for (int i = 0; i < num_ports; i++) {
+            struct output_port *port = &ports[i];
+            if (port->failed) continue;
+            const int failed = port->result;
+            port->errors = (port->errors << 1) | (failed ? 1 : 0);
+            sent |= !failed;
+            if (port->errors == 0xFF) {
+                // If 8 errors have occured in a row, stop using the port. This usually means that the DMX output device has been disconected.
+                port->failed = 1;
+                live_ports--;
+            }
+        }
+        if (sent) {
+            device->stats.frames++;
+            signal_frame(device, monotonic_time());
+        }
+        if (live_ports == 0) {
+            // Every port has failed, stop DMX output and register an error
+            if (num_ports > 1) {
+                stop_senders(&senders, ports, num_ports);
+            }
+            release_ports(ports + 1, num_ports - 1);
+            signal_stopped(device, 1);
             return -1;
         }
-        device->lock = lock_status;
-        // Wait for the interpacket time
-        struct timespec tim;
-        tim.tv_sec = 0;
-        tim.tv_nsec = opendmx_interpacket_time;
-        nanosleep(&tim, NULL);
+        // The next frame is due once this one has been transmitted and the interpacket time has passed
+        deadline += OPENDMX_PACKET_TIME + opendmx_interpacket_time;
+        if (deadline < now) {
+            deadline = now;     // Fell more than a frame behind, don't try to catch up with a burst of frames
+        }
+    }
+    if (num_ports > 1) {
+        stop_senders(&senders, ports, num_ports);
     }
+    // The other ports are released first, once device is released the group may be freed
+    release_ports(ports + 1, num_ports - 1);
+    signal_stopped(device, 0);
     return 0;
 }
 
+int opendmx_start (opendmx_device *device) {
+    if (device->client) {
+        return -1;  // The output belongs to another process
+    }
+    struct output_port port = { .device = device };
+    return run_output(device, &port, 1);
+}
+
+int opendmx_set_frame_hook (opendmx_device *device, opendmx_frame_hook hook, void *context, long lead_time) {
+    if (device->client) {
+        return -1;  // The output stage belongs to the process which owns the universe
+    }
+    pthread_mutex_lock(&device->stage_lock);
+    device->frame_hook = hook;
+    device->frame_hook_context = context;
+    device->frame_hook_lead_time = ((hook != NULL) && (lead_time > 0)) ? lead_time : 0;
+    // Wait for a call to the old hook to finish so that its context can be freed, unless the hook is replacing itself
+    while (device->frame_hook_running && !pthread_equal(device->frame_hook_thread, pthread_self())) {
+        pthread_cond_wait(&device->frame_hook_done, &device->stage_lock);
+    }
+    pthread_mutex_unlock(&device->stage_lock);
+    return 0;
+}
+
+void opendmx_get_stats (const opendmx_device *device, struct opendmx_stats *stats) {
+    *stats = device->stats;
+}
+
 void opendmx_stop (opendmx_device *device) {
+    // Wakes the output loop if it is sleeping, so that it stops straight away
+    pthread_mutex_lock(&device->frame_lock);
     device->running = 0;
+    pthread_cond_broadcast(&device->frame_sent);
+    pthread_mutex_unlock(&device->frame_lock);
 }
 
 int opendmx_close_device (opendmx_device *device) {
+    pthread_mutex_lock(&device->frame_lock);
+    const int in_group = (device->output_owner != NULL) && (device->output_owner != device);
+    pthread_mutex_unlock(&device->frame_lock);
+    if (in_group) {
+        return 1;   // The device is a port of a running group, the group must be stopped first
+    }
     opendmx_stop(device);
-    while (device->lock);
-    if (close_output(device) != 0) return 1;
+    wait_output_stopped(device);
+    if (device->client) {
+        munmap(device->universe, sizeof(*device->universe));
+    } else {
+        if (close_output(device) != 0) return 1;
+        if (device->shared) {
+            munmap(device->universe, sizeof(*device->universe));
+            shm_unlink(device->shared_name);
+            free(device->shared_name);
+        }
+    }
+    deinit_device(device);
     free(device);
     return 0;
 }
 
+// MARK: Output Groups
+opendmx_group *opendmx_create_group (opendmx_device **devices, int count) {
+    if (count < 1) {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        if (devices[i]->client) {
+            return NULL;    // Can't output on a universe owned by another process
+        }
+        for (int j = 0; j < i; j++) {
+            if (devices[i] == devices[j]) return NULL;
+        }
+    }
+    opendmx_group *group = malloc(sizeof(*group) + count * sizeof(struct output_port));
+    if (group == NULL) {
+        return NULL;
+    }
+    group->num_ports = count;
+    for (int i = 0; i < count; i++) {
+        group->ports[i].device = devices[i];
+        group->ports[i].errors = 0;
+        group->ports[i].failed = 0;
+    }
+    return group;
+}
+
+void *opendmx_group_thread (void *group) {
+    opendmx_group_start((opendmx_group *)group);
+    return NULL;
+}
+
+int opendmx_group_start (opendmx_group *group) {
+    return run_output(group->ports[0].device, group->ports, group->num_ports);
+}
+
+void opendmx_group_stop (opendmx_group *group) {
+    opendmx_stop(group->ports[0].device);
+}
+
+opendmx_device *opendmx_group_universe (const opendmx_group *group) {
+    return group->ports[0].device;
+}
+
+int opendmx_group_port_ok (const opendmx_group *group, int port) {
+    return (0 <= port) && (port < group->num_ports) && !group->ports[port].failed;
+}
+
+int opendmx_group_primary (const opendmx_group *group) {
+    for (int i = 0; i < group->num_ports; i++) {
+        if (!group->ports[i].failed) return i;
+    }
+    return -1;
+}
+
+void opendmx_free_group (opendmx_group *group) {
+    opendmx_group_stop(group);
+    wait_output_stopped(group->ports[0].device);
+    free(group);
+}
+
 uint8_t opendmx_get_slot (const opendmx_device *device, int slot) {
-    return ((0 <= slot) && (slot < OPENDMX_UNIVERSE_LENGTH)) ? device->slots[slot] : 0;
+    return ((0 <= slot) && (slot < OPENDMX_UNIVERSE_LENGTH)) ? device->universe->slots[slot] : 0;
 }
 
 int opendmx_set_slot (opendmx_device *device, int slot, uint8_t value) {
     if ((0 > slot) || (slot >= OPENDMX_UNIVERSE_LENGTH)) {
         return -1;
     }
-    device->slots[slot] = value;
+    begin_write(device);
+    device->universe->slots[slot] = value;
+    end_write(device);
     return 0;
 }
 
-# ifndef OPENDMX_USE_D2XX
+int opendmx_get_slots (const opendmx_device *device, int first_slot, uint8_t *buffer, int count) {
+    if ((0 > first_slot) || (0 > count) || (first_slot + count > OPENDMX_UNIVERSE_LENGTH)) {
+        return -1;
+    }
+    if (device->shared) {
+        uint8_t universe[OPENDMX_UNIVERSE_LENGTH];
+        read_universe(device, universe);
+        memcpy(buffer, universe + first_slot, count);
+    } else {
+        memcpy(buffer, device->universe->slots + first_slot, count);
+    }
+    return 0;
+}
+
+int opendmx_set_slots (opendmx_device *device, int first_slot, const uint8_t *values, int count) {
+    if ((0 > first_slot) || (0 > count) || (first_slot + count > OPENDMX_UNIVERSE_LENGTH)) {
+        return -1;
+    }
+    begin_write(device);
+    memcpy(device->universe->slots + first_slot, values, count);
+    end_write(device);
+    return 0;
+}
+
+uint8_t *opendmx_begin_update (opendmx_device *device) {
+    begin_write(device);
+    return device->universe->slots;
+}
+
+void opendmx_end_update (opendmx_device *device) {
+    end_write(device);
+}
+
+// MARK: Shared Universes
+static struct opendmx_universe *map_universe (int fd) {
+    void *universe = mmap(NULL, sizeof(struct opendmx_universe), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping stays valid once the file is closed
+    return (universe != MAP_FAILED) ? universe : NULL;
+}
+
+int opendmx_share_universe (opendmx_device *device, const char *name) {
+    if (device->shared) {
+        return -1;  // Already shared
+    }
+    char *shared_name = malloc(strlen(name) + 1);
+    if (shared_name == NULL) {
+        goto error;
+    }
+    strcpy(shared_name, name);
+    
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd == -1) {
+        goto error;
+    }
+    if (ftruncate(fd, sizeof(struct opendmx_universe)) != 0) {
+        close(fd);
+        goto error_with_segment;
+    }
+    struct opendmx_universe *universe = map_universe(fd);
+    if (universe == NULL) {
+        goto error_with_segment;
+    }
+    
+    // Start from the current slot values, the segment only becomes valid for clients once the magic number is set
+    memcpy(universe->slots, device->universe->slots, OPENDMX_UNIVERSE_LENGTH);
+    universe->generation = 0;
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+#ifndef __APPLE__
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+#endif
+    const int initialized = pthread_mutex_init(&universe->write_lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    if (initialized != 0) {
+        munmap(universe, sizeof(*universe));
+        goto error_with_segment;
+    }
+    __atomic_store_n(&universe->magic, OPENDMX_SHARED_MAGIC, __ATOMIC_RELEASE);
+    
+    pthread_mutex_lock(&device->stage_lock);
+    device->universe = universe;
+    device->shared = 1;
+    device->shared_name = shared_name;
+    pthread_mutex_unlock(&device->stage_lock);
+    return 0;
+    
+error_with_segment:
+    shm_unlink(name);
+error:
+    free(shared_name);
+    return -1;
+}
+
+opendmx_device *opendmx_attach_universe (const char *name) {
+    struct opendmx_handle *device = malloc(sizeof(*device));
+    if (device == NULL) {
+        return NULL;
+    }
+    init_device(device);
+    
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) {
+        goto error;
+    }
+    // The owner creates the segment before sizing it, mapping past the end of a segment which is too small would raise SIGBUS
+    struct stat segment;
+    if ((fstat(fd, &segment) != 0) || (segment.st_size < (off_t)sizeof(struct opendmx_universe))) {
+        close(fd);
+        goto error;
+    }
+    struct opendmx_universe *universe = map_universe(fd);
+    if (universe == NULL) {
+        goto error;
+    }
+    if (__atomic_load_n(&universe->magic, __ATOMIC_ACQUIRE) != OPENDMX_SHARED_MAGIC) {
+        munmap(universe, sizeof(*universe));
+        goto error;     // Not a universe, or the owner has not finished setting it up
+    }
+    
+    device->universe = universe;
+    device->shared = 1;
+    device->client = 1;
+    return device;
+    
+error:
+    deinit_device(device);
+    free(device);
+    return NULL;
+}
+
+static void group_curves (opendmx_device *device) {
+    // Counting sort of the slots by curve
+    int counts[OPENDMX_MAX_CURVES + 1] = {0};
+    for (int i = 0; i < OPENDMX_UNIVERSE_LENGTH; i++) {
+        counts[device->slot_curves[i]]++;
+    }
+    int end = 0;
+    for (int c = 1; c <= OPENDMX_MAX_CURVES; c++) {
+        end += counts[c];
+        device->curve_group_end[c] = end;
+    }
+    int next[OPENDMX_MAX_CURVES + 1];
+    next[0] = 0;
+    for (int c = 1; c <= OPENDMX_MAX_CURVES; c++) {
+        next[c] = device->curve_group_end[c - 1];
+    }
+    for (int i = 0; i < OPENDMX_UNIVERSE_LENGTH; i++) {
+        const int c = device->slot_curves[i];
+        if (c != 0) {
+            device->curve_slots[next[c]++] = i;
+        }
+    }
+}
+
+static int find_curve (opendmx_device *device, const uint8_t *curve, int first_slot, int count) {
+    int identity = 1;
+    for (int i = 0; (i < 256) && identity; i++) {
+        identity = (curve[i] == i);
+    }
+    if (identity) return 0;
+    
+    // Determine which curves will still be in use once the range has been reassigned
+    int in_use[OPENDMX_MAX_CURVES + 1] = {0};
+    for (int i = 0; i < OPENDMX_UNIVERSE_LENGTH; i++) {
+        if ((i < first_slot) || (i >= first_slot + count)) {
+            in_use[device->slot_curves[i]] = 1;
+        }
+    }
+    // Share an existing table if there is one, otherwise take the first free table
+    int free_curve = -1;
+    for (int c = 1; c <= OPENDMX_MAX_CURVES; c++) {
+        if (!in_use[c]) {
+            if (free_curve < 0) free_curve = c;
+        } else if (memcmp(device->curves[c], curve, 256) == 0) {
+            return c;
+        }
+    }
+    if (free_curve > 0) {
+        memcpy(device->curves[free_curve], curve, 256);
+    }
+    return free_curve;
+}
+
+int opendmx_set_curve (opendmx_device *device, int first_slot, int count, const uint8_t *curve) {
+    if (device->client) {
+        return -1;  // The output stage belongs to the process which owns the universe
+    }
+    if ((0 > first_slot) || (0 > count) || (first_slot + count > OPENDMX_UNIVERSE_LENGTH)) {
+        return -1;
+    }
+    pthread_mutex_lock(&device->stage_lock);
+    const int index = (curve == NULL) ? 0 : find_curve(device, curve, first_slot, count);
+    if (index < 0) {
+        pthread_mutex_unlock(&device->stage_lock);
+        return -1;  // No free curves
+    }
+    for (int i = first_slot; i < first_slot + count; i++) {
+        device->slot_curves[i] = index;
+    }
+    group_curves(device);
+    pthread_mutex_unlock(&device->stage_lock);
+    return 0;
+}
+
+void opendmx_curve_build (uint8_t *curve, double gamma, uint8_t low, uint8_t high) {
+    for (int i = 0; i < 256; i++) {
+        curve[i] = (uint8_t)lround(low + (high - low) * pow(i / 255.0, gamma));
+    }
+}
+
+opendmx_effect_handle *opendmx_add_effect (opendmx_device *device, const struct opendmx_effect *effect) {
+    if (device->client) {
+        return NULL;    // The output stage belongs to the process which owns the universe
+    }
+    if ((0 > effect->first_slot) || (0 > effect->count) || (effect->first_slot + effect->count > OPENDMX_UNIVERSE_LENGTH)) {
+        return NULL;
+    }
+    if (effect->period <= 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&device->stage_lock);
+    opendmx_effect_handle *state = (opendmx_effect_handle *)list_append(&device->effects, sizeof(*state));
+    if (state != NULL) {
+        state->effect = *effect;
+        state->start = monotonic_time();
+        render_waveform(state);
+    }
+    pthread_mutex_unlock(&device->stage_lock);
+    return state;
+}
+
+int opendmx_remove_effect (opendmx_device *device, opendmx_effect_handle *effect) {
+    pthread_mutex_lock(&device->stage_lock);
+    struct list_node *node = device->effects.first;
+    for (int i = 0; i < device->effects.length; i++, node = node->next) {
+        if (node->value == (char *)effect) {
+            list_remove(&device->effects, i);
+            pthread_mutex_unlock(&device->stage_lock);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&device->stage_lock);
+    return -1;
+}
+
+#ifdef OPENDMX_USE_SERIAL
 #ifdef __linux__
 static char *trim_path(char *path) {
     // Get string starting at the beginig of the device name
@@ -344,7 +1556,7 @@ struct opendmx_iterator *opendmx_get_devices () {
 #endif
     return 0;
 }
-#endif // not OPENDMX_USE_D2XX
+#endif // OPENDMX_USE_SERIAL
 
 int opendmx_is_running (opendmx_device *device) {
     return device->running;
@@ -354,6 +1566,214 @@ int opendmx_has_error (opendmx_device *device) {
     return device->error;
 }
 
+// MARK: Input
+static void publish_input_frame (opendmx_input *input, uint64_t timestamp) {
+    input->staging.timestamp = timestamp;
+    input->stats.frames++;
+    
+    const uint32_t head = input->head;
+    if (head - __atomic_load_n(&input->tail, __ATOMIC_ACQUIRE) < OPENDMX_INPUT_RING_LENGTH) {
+        struct opendmx_input_frame *frame = &input->ring[head % OPENDMX_INPUT_RING_LENGTH];
+        frame->timestamp = timestamp;
+        frame->start_code = input->staging.start_code;
+        frame->length = input->staging.length;
+        memcpy(frame->slots, input->staging.slots, input->staging.length);
+        __atomic_store_n(&input->head, head + 1, __ATOMIC_RELEASE);
+    } else {
+        input->stats.dropped_frames++;     // The application is not reading frames fast enough
+    }
+    
+    // Measure the frame rate over windows of about a second
+    input->window_frames++;
+    const uint64_t elapsed = timestamp - input->window_start;
+    if (elapsed >= 1000000000) {
+        input->stats.frame_rate = input->window_frames * 1e9 / elapsed;
+        input->window_start = timestamp;
+        input->window_frames = 0;
+    }
+}
+
+static void parse_input_data (opendmx_input *input, uint8_t byte, uint64_t timestamp) {
+    switch (input->state) {
+        case INPUT_WAIT_BREAK:
+            break;
+        case INPUT_START_CODE:
+            input->staging.start_code = byte;
+            input->staging.length = 0;
+            input->state = INPUT_SLOTS;
+            break;
+        case INPUT_SLOTS:
+            input->staging.slots[input->staging.length++] = byte;
+            if (input->staging.length == OPENDMX_UNIVERSE_LENGTH) {
+                // A full universe, there is no need to wait for the next break to know that the frame is complete
+                publish_input_frame(input, timestamp);
+                input->state = INPUT_WAIT_BREAK;
+            }
+            break;
+    }
+}
+
+static void parse_input_mark (opendmx_input *input, uint8_t byte, uint64_t timestamp) {
+    if (byte == 0) {
+        // A break, this ends any frame in progress
+        input->stats.breaks++;
+        if ((input->state == INPUT_SLOTS) && (input->staging.length > 0)) {
+            publish_input_frame(input, timestamp);
+        }
+        input->state = INPUT_START_CODE;
+    } else {
+        // A framing or parity error in the middle of a frame, the frame is discarded
+        input->stats.framing_errors++;
+        input->state = INPUT_WAIT_BREAK;
+    }
+}
+
+int opendmx_input_feed (opendmx_input *input, const uint8_t *bytes, int length) {
+    const uint64_t timestamp = monotonic_time();
+    for (int i = 0; i < length; i++) {
+        const uint8_t byte = bytes[i];
+        switch (input->marks) {
+            case 0:
+                if (byte == 0xFF) {
+                    input->marks = 1;
+                } else {
+                    parse_input_data(input, byte, timestamp);
+                }
+                break;
+            case 1:
+                if (byte == 0x00) {
+                    input->marks = 2;
+                } else {
+                    // 0xFF 0xFF is an escaped 0xFF, anything else is a lone 0xFF from a stream without marks
+                    input->marks = 0;
+                    parse_input_data(input, 0xFF, timestamp);
+                    if (byte != 0xFF) {
+                        i--;    // Parse this byte again on its own
+                    }
+                }
+                break;
+            case 2:
+                input->marks = 0;
+                parse_input_mark(input, byte, timestamp);
+                break;
+        }
+    }
+    return 0;
+}
+
+opendmx_input *opendmx_open_input (const char *port_name) {
+    opendmx_input *input = malloc(sizeof(*input));
+    if (input == NULL) {
+        return NULL;
+    }
+    memset(input, 0, sizeof(*input));
+    pthread_mutex_init(&input->lock, NULL);
+    pthread_cond_init(&input->stopped, NULL);
+    input->port = -1;
+    input->state = INPUT_WAIT_BREAK;
+    input->window_start = monotonic_time();
+    
+    if ((port_name != NULL) && (open_input_port(input, port_name) != 0)) {
+        pthread_mutex_destroy(&input->lock);
+        pthread_cond_destroy(&input->stopped);
+        free(input);
+        return NULL;
+    }
+    return input;
+}
+
+void *opendmx_input_thread (void *input) {
+    opendmx_input_start((opendmx_input *)input);
+    return NULL;
+}
+
+static int input_running (opendmx_input *input) {
+    pthread_mutex_lock(&input->lock);
+    const int running = input->running;
+    pthread_mutex_unlock(&input->lock);
+    return running;
+}
+
+int opendmx_input_start (opendmx_input *input) {
+    if (input->port == -1) {
+        return -1;  // Nothing to read from
+    }
+    pthread_mutex_lock(&input->lock);
+    if (input->active) {
+        pthread_mutex_unlock(&input->lock);
+        return -1;  // Already receiving on another thread
+    }
+    input->active = 1;
+    input->running = 1;
+    input->error = 0;
+    pthread_mutex_unlock(&input->lock);
+    
+    int result = 0;
+    uint8_t buffer[1024];
+    // Reads time out after 100ms, so a stop is noticed within that time even if nothing is being received
+    while (input_running(input)) {
+        const int count = read_input_port(input, buffer, sizeof(buffer));
+        if (count < 0) {
+            result = -1;    // The port has gone away
+            break;
+        }
+        opendmx_input_feed(input, buffer, count);
+    }
+    
+    // The input may be freed as soon as active is cleared, so it must not be touched after the lock is released
+    pthread_mutex_lock(&input->lock);
+    input->running = 0;
+    input->error = (result != 0);
+    input->active = 0;
+    pthread_cond_broadcast(&input->stopped);
+    pthread_mutex_unlock(&input->lock);
+    return result;
+}
+
+void opendmx_input_stop (opendmx_input *input) {
+    pthread_mutex_lock(&input->lock);
+    input->running = 0;
+    pthread_mutex_unlock(&input->lock);
+}
+
+void opendmx_close_input (opendmx_input *input) {
+    pthread_mutex_lock(&input->lock);
+    input->running = 0;
+    while (input->active) {
+        pthread_cond_wait(&input->stopped, &input->lock);
+    }
+    pthread_mutex_unlock(&input->lock);
+    if (input->port != -1) {
+        close_input_port(input);
+    }
+    pthread_mutex_destroy(&input->lock);
+    pthread_cond_destroy(&input->stopped);
+    free(input);
+}
+
+int opendmx_input_read_frame (opendmx_input *input, struct opendmx_input_frame *frame) {
+    const uint32_t tail = input->tail;
+    if (tail == __atomic_load_n(&input->head, __ATOMIC_ACQUIRE)) {
+        return -1;  // No frames waiting
+    }
+    const struct opendmx_input_frame *received = &input->ring[tail % OPENDMX_INPUT_RING_LENGTH];
+    frame->timestamp = received->timestamp;
+    frame->start_code = received->start_code;
+    frame->length = received->length;
+    memcpy(frame->slots, received->slots, received->length);
+    __atomic_store_n(&input->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void opendmx_input_get_stats (const opendmx_input *input, struct opendmx_input_stats *stats) {
+    *stats = input->stats;
+    // The rate is only updated when a frame arrives, once frames stop the window is left open and is measured up to now instead
+    const uint64_t elapsed = monotonic_time() - input->window_start;
+    if (elapsed > 1000000000) {
+        stats->frame_rate = input->window_frames * 1e9 / elapsed;
+    }
+}
+
 // MARK: Iterator
 char *opendmx_iterator_next (struct opendmx_iterator *iter) {
     return list_iterator_next(iter->iterator);
@@ -381,30 +1801,43 @@ int opendmx_iterator_to_array (const struct opendmx_iterator *iter, char **buffe
 
 //-------D2XX--------
 #ifdef OPENDMX_USE_D2XX
-#include "/usr/local/include/ftd2xx.h"
+#include <ftd2xx.h>
+
+#define OPENDMX_BREAK_TIME          110000  // Break length in nanoseconds, the minimum is 88µs. The mark after break comes from the USB latency before the data.
+#define OPENDMX_LATENCY_TIMER       2       // Milliseconds before the FTDI chip returns a partial USB packet, the minimum
+#define OPENDMX_USB_TRANSFER_SIZE   576     // Bytes per USB transfer, a multiple of 64 which fits a whole DMX packet
+#define OPENDMX_WRITE_TIMEOUT       25      // Milliseconds before a stalled write fails, a little longer than a packet takes to send
 
-opendmx_device *opendmx_open_device(char* serial_number) {
+opendmx_device *opendmx_open_device (const char *serial_number) {
     struct opendmx_handle *device = malloc(sizeof(*device));
     
     FT_STATUS ftstatus;
     
     // Open the device
-    ftstatus = FT_OpenEx(serial_number, FT_OPEN_BY_SERIAL_NUMBER, &device->ftdi_handle);
+    ftstatus = FT_OpenEx((PVOID)serial_number, FT_OPEN_BY_SERIAL_NUMBER, &device->ftdi_handle);
 //    ftstatus = FT_Open(0, &device->ftdi_handle);
     if (ftstatus != FT_OK) goto error;
     
-    // Set device settings
-    ftstatus = FT_SetBaudRate(device->ftdi_handle, 250000);
+    // Set device settings, everything is configured once here so that sending a packet only needs a break and one write
+    ftstatus = FT_SetBaudRate(device->ftdi_handle, OPENDMX_DATA_BAUD_RATE);
     if (ftstatus != FT_OK) goto error_with_open_device;
     ftstatus = FT_SetDataCharacteristics(device->ftdi_handle, FT_BITS_8, FT_STOP_BITS_2, FT_PARITY_NONE);
     if (ftstatus != FT_OK) goto error_with_open_device;
+    ftstatus = FT_SetFlowControl(device->ftdi_handle, FT_FLOW_NONE, 0, 0);
+    if (ftstatus != FT_OK) goto error_with_open_device;
+    ftstatus = FT_ClrRts(device->ftdi_handle);   // Enables the line driver on Open DMX style interfaces
+    if (ftstatus != FT_OK) goto error_with_open_device;
+    ftstatus = FT_SetLatencyTimer(device->ftdi_handle, OPENDMX_LATENCY_TIMER);
+    if (ftstatus != FT_OK) goto error_with_open_device;
+    ftstatus = FT_SetUSBParameters(device->ftdi_handle, OPENDMX_USB_TRANSFER_SIZE, OPENDMX_USB_TRANSFER_SIZE);
+    if (ftstatus != FT_OK) goto error_with_open_device;
+    ftstatus = FT_Purge(device->ftdi_handle, FT_PURGE_RX | FT_PURGE_TX);
+    if (ftstatus != FT_OK) goto error_with_open_device;
+    // A stalled interface must not hold up the other ports in a group, so writes give up rather than blocking
+    ftstatus = FT_SetTimeouts(device->ftdi_handle, OPENDMX_WRITE_TIMEOUT, OPENDMX_WRITE_TIMEOUT);
+    if (ftstatus != FT_OK) goto error_with_open_device;
     
-    // Initialize universe
-    for (int i = 0; i < OPENDMX_UNIVERSE_LENGTH; i++) {
-        device->slots[i] = 0;
-    }
-    
-    device->lock = 0;
+    init_device(device);
     
     return device;
     
@@ -415,17 +1848,14 @@ error:
     return NULL;
 }
 
-static int send_packet (opendmx_device *device) {
-    int break_byte = 0; // Need to define this as a variable so I that can get a pointer to it
-    uint bytes_sent = 0;
-    int error = FT_SetBaudRate(device->ftdi_handle, OPENDMX_BREAK_BAUD_RATE) != FT_OK;                        // Drop to lower baud rate
-    error = error || FT_Write(device->ftdi_handle, &break_byte, 1, &bytes_sent)  != FT_OK;  // transmit a zero
-    error = error || bytes_sent != 1;
-    error = error || FT_SetBaudRate(device->ftdi_handle, OPENDMX_DATA_BAUD_RATE) != FT_OK;                  // Return to the proper baud rate
-    error = error || FT_Write(device->ftdi_handle, &opendmx_start_byte, 1, &bytes_sent) != FT_OK;// send the start code
-    error = error || bytes_sent != 1;
-    error = error || FT_Write(device->ftdi_handle, device->slots, OPENDMX_UNIVERSE_LENGTH, &bytes_sent) != FT_OK;  // send the DMX slots
-    error = error || bytes_sent != OPENDMX_UNIVERSE_LENGTH;
+static int send_packet (opendmx_device *device, const uint8_t *packet) {
+    DWORD bytes_sent = 0;
+    const struct timespec break_time = { 0, OPENDMX_BREAK_TIME };
+    int error = FT_SetBreakOn(device->ftdi_handle) != FT_OK;     // Hold the line low
+    nanosleep(&break_time, NULL);
+    error = error || FT_SetBreakOff(device->ftdi_handle) != FT_OK;
+    error = error || FT_Write(device->ftdi_handle, (LPVOID)packet, OPENDMX_PACKET_LENGTH, &bytes_sent) != FT_OK;  // send the start code and the DMX slots
+    error = error || bytes_sent != OPENDMX_PACKET_LENGTH;
     return error;
 }
 
@@ -433,22 +1863,34 @@ static int close_output (const opendmx_device *device) {
     return FT_Close(device->ftdi_handle) != FT_OK;
 }
 
+// DMX input is only supported through the serial port drivers, bytes can still be fed to an input with opendmx_input_feed
+static int open_input_port (opendmx_input *input, const char *port_name) {
+    return -1;
+}
+
+static int read_input_port (opendmx_input *input, uint8_t *buffer, int length) {
+    return -1;
+}
+
+static void close_input_port (opendmx_input *input) {
+}
+
 struct opendmx_iterator *opendmx_get_devices () {
     FT_STATUS ftstatus;
-    unsigned int num_devs;
+    DWORD num_devs;
     
     struct list *devices = malloc(sizeof(*devices));
     devices->first = NULL;
     devices->length = 0;
 
-    ftstatus = FT_ListDevices(&num_devs,NULL,FT_LIST_NUMBER_ONLY);
+    ftstatus = FT_ListDevices(&num_devs, NULL, FT_LIST_NUMBER_ONLY);
     if (ftstatus != FT_OK) goto error;
     
     for (int i = 0; i < num_devs; i++) {
         list_append(devices, 64);
     }
     
-    char **serial_nums = malloc(sizeof(char*) * num_devs + 1);
+    char **serial_nums = malloc(sizeof(char*) * (num_devs + 1));
     list_array(devices, serial_nums, num_devs);
     serial_nums[num_devs] = NULL;
     
@@ -463,7 +1905,60 @@ struct opendmx_iterator *opendmx_get_devices () {
     return device_list;
 error:
     list_free(devices);
+    free(devices);
     return NULL;
 }
 
 #endif // OPENDMX_USE_D2XX
+
+
+//-------Virtual--------
+#ifdef OPENDMX_USE_VIRTUAL
+// A backend without any hardware, used for benchmarking and for running applications where no DMX interface is available.
+#define OPENDMX_VIRTUAL_DEVICES 8
+
+opendmx_device *opendmx_open_device (const char *name) {
+    struct opendmx_handle *device = malloc(sizeof(*device));
+    if (device == NULL) return NULL;
+    
+    init_device(device);
+    
+    return device;
+}
+
+static int send_packet (opendmx_device *device, const uint8_t *packet) {
+    return 0;   // Frames sent are counted in the device's stats
+}
+
+static int close_output (const opendmx_device *device) {
+    return 0;
+}
+
+static int open_input_port (opendmx_input *input, const char *port_name) {
+    return -1;  // There is nothing to receive from, bytes can be fed to an input with opendmx_input_feed
+}
+
+static int read_input_port (opendmx_input *input, uint8_t *buffer, int length) {
+    return -1;
+}
+
+static void close_input_port (opendmx_input *input) {
+}
+
+struct opendmx_iterator *opendmx_get_devices () {
+    struct list *devices = malloc(sizeof(*devices));
+    devices->first = NULL;
+    devices->length = 0;
+    
+    for (int i = 0; i < OPENDMX_VIRTUAL_DEVICES; i++) {
+        char *name = list_append(devices, OPENDMX_MAX_DEV_NAME_LENGTH);
+        snprintf(name, OPENDMX_MAX_DEV_NAME_LENGTH, "virtual%d", i);
+    }
+    
+    struct opendmx_iterator *device_list = malloc(sizeof(*device_list));
+    device_list->list = devices;
+    device_list->iterator = list_iterator(devices);
+    return device_list;
+}
+
+#endif // OPENDMX_USE_VIRTUAL
@@ -11,8 +11,13 @@
 
 #include <inttypes.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define OPENDMX_UNIVERSE_LENGTH     512
 // Packet length = 104µs (break) + 26µs (MAB) + 40µs (start) + 20480µs (slots) = 20650000 nanoseconds
+#define OPENDMX_PACKET_TIME         20650000
 // Interpacket times:
 #define OPENDMX_PERIOD_HIGH         4350000         // 4350000 + 20650000 = 25000000 nanoseconds per packet = 40pps
 #define OPENDMX_PERIOD_MID          12683333        // 12683333 + 20650000 = 33333333 nanoseconds per packet = 30pps
@@ -20,10 +25,99 @@
 
 #define OPENDMX_MAX_DEV_NAME_LENGTH 64
 
+#define OPENDMX_MAX_CURVES          15              // Maximum number of distinct response curves per device
+#define OPENDMX_INPUT_RING_LENGTH   16              // Number of received frames buffered for each input
+
 typedef struct opendmx_handle opendmx_device;
+typedef struct opendmx_input_handle opendmx_input;
+typedef struct opendmx_group_handle opendmx_group;
+typedef struct opendmx_effect_handle opendmx_effect_handle;
+
+enum opendmx_waveform {
+    OPENDMX_WAVE_SINE,
+    OPENDMX_WAVE_TRIANGLE,
+    OPENDMX_WAVE_SAW,
+    OPENDMX_WAVE_SQUARE
+};
+
+enum opendmx_compose {
+    OPENDMX_COMPOSE_REPLACE,        // The effect's value replaces the slot's value
+    OPENDMX_COMPOSE_ADD,            // The effect's value is added to the slot's value
+    OPENDMX_COMPOSE_MAX             // The higher of the effect's value and the slot's value is used
+};
+
+/**
+ *  A waveform evaluated for a range of slots every frame.
+ *  @note Phases are fractions of a cycle where 65536 is a full cycle. A chase across n slots uses a phase_step of 65536 / n.
+ */
+struct opendmx_effect {
+    enum opendmx_waveform   waveform;
+    enum opendmx_compose    compose;
+    int                     first_slot;
+    int                     count;
+    long long               period;         // Length of one cycle in nanoseconds
+    uint16_t                phase;          // Phase of the first slot
+    uint16_t                phase_step;     // Phase offset between adjacent slots
+    uint16_t                duty;           // Portion of the cycle for which a square wave is high
+    uint8_t                 low;            // Value at the bottom of the waveform
+    uint8_t                 high;           // Value at the top of the waveform
+};
 
 struct opendmx_iterator;
 
+/**
+ *  Called by opendmx_start shortly before each frame is sent.
+ *  @param device The device which is sending the frame.
+ *  @param frame The outgoing frame, OPENDMX_UNIVERSE_LENGTH slots which can be written in place. Effects have already been applied, response curves are applied after the hook returns.
+ *  @param deadline The CLOCK_MONOTONIC time in nanoseconds at which the frame will be sent.
+ *  @param context The context given when the hook was set.
+ */
+typedef void (*opendmx_frame_hook) (opendmx_device *device, uint8_t *frame, uint64_t deadline, void *context);
+
+/**
+ *  Identifies a frame sent by an opendmx device.
+ */
+struct opendmx_frame_info {
+    uint64_t                sequence;           // Number of frames sent by the device, including this one
+    uint64_t                timestamp;          // CLOCK_MONOTONIC time at which the frame was sent in nanoseconds
+};
+
+/**
+ *  Output statistics for an opendmx device. Times are in nanoseconds.
+ */
+struct opendmx_stats {
+    unsigned long           frames;             // Frames sent
+    unsigned long           late_frames;        // Frames sent more than a millisecond after they were due
+    unsigned long           torn_frames;        // Frames sent from a shared universe which was being written to at the time
+    uint64_t                hook_time_last;     // Run time of the most recent call to the frame hook
+    uint64_t                hook_time_max;      // Longest run time of the frame hook
+    uint64_t                hook_time_total;    // Total run time of the frame hook
+};
+
+/**
+ *  A DMX frame received by an opendmx_input.
+ */
+struct opendmx_input_frame {
+    uint64_t                timestamp;      // CLOCK_MONOTONIC time at which the frame was received in nanoseconds
+    uint8_t                 start_code;
+    int                     length;         // Number of slots in the frame
+    uint8_t                 slots[OPENDMX_UNIVERSE_LENGTH];
+};
+
+/**
+ *  Statistics for an opendmx_input.
+ */
+struct opendmx_input_stats {
+    unsigned long           frames;                 // Frames received
+    unsigned long           dropped_frames;         // Frames discarded because the ring of received frames was full
+    unsigned long           breaks;                 // Breaks received
+    unsigned long           framing_errors;         // Framing or parity errors outside of a break, the frame in progress is discarded
+    double                  frame_rate;             // Frames per second, measured over about the last second, falls towards 0 once frames stop
+    unsigned long           line_breaks;            // Breaks counted by the serial driver (Linux only)
+    unsigned long           line_framing_errors;    // Framing errors counted by the serial driver (Linux only)
+    unsigned long           line_overruns;          // Bytes lost by the serial driver (Linux only)
+};
+
 /**
  *  The start byte for dmx packets
  */
@@ -39,7 +133,7 @@ extern long opendmx_interpacket_time;
  *  @param device_file Path to the serial device to be used, must support 250k and 76.8k baud
  *  @returns A pointer to an opendmx_handle, or NULL if device creation failed
  */
-extern opendmx_device *opendmx_open_device(char* device_file);
+extern opendmx_device *opendmx_open_device(const char *device_file);
 
 /**
  *  A helper function designed to be used with a pthread. Calls opendmx_start.
@@ -52,23 +146,82 @@ extern void *opendmx_thread (void *device);
  *  Starts DMX output.
  *  @note This function blocks the thread it is called on until dmx output for the device is stoped.
  *  @param device The divice on which to output DMX
- *  @return 0 if DMX output is successful, < 0 if
+ *  @return 0 if DMX output is successful, < 0 if output is already running on the device or the device has failed
  */
 extern int opendmx_start (opendmx_device *device);
 
 /**
- *  Stops DMX output.
+ *  Stops DMX output. The output loop is woken if it is waiting for the next frame, so it stops straight away.
  *  @param device The device for which the DMX output is to be stopped.
  */
 extern void opendmx_stop (opendmx_device *device);
 
 /**
- *  Closes and frees opendmx device.
+ *  Closes and frees opendmx device. Output is stopped first, this waits for the output loop to finish.
  *  @param device The handle to be closed.
- *  @return 0 if device successfully closed, > 0 otherwise
+ *  @return 0 if device successfully closed, > 0 otherwise. A device which is sending for a running group can't be closed until the group is stopped.
  */
 extern int opendmx_close_device (opendmx_device *device);
 
+/**
+ *  Create an output group, which mirrors one universe onto several devices for redundancy. Each frame is built once, from the first device's universe, and sent on every device in the group.
+ *  @note A device which fails to send 8 frames in a row is dropped from the group while the others carry on transmitting. Output only stops with an error once every device has failed.
+ *  @note Each device is sent to from its own thread. A send which hasn't finished by the time the packet should have been transmitted counts as a failure, so a stalled device doesn't delay the others.
+ *  @param devices The devices in the group, the first one's universe, effects, curves, hook and schedule are used for the group.
+ *  @param count The number of devices.
+ *  @returns A pointer to an opendmx_group, or NULL if the group could not be created.
+ */
+extern opendmx_group *opendmx_create_group (opendmx_device **devices, int count);
+
+/**
+ *  A helper function designed to be used with a pthread. Calls opendmx_group_start.
+ *  @param group The group on which to output DMX, must be an opendmx_group
+ *  @returns NULL, will not return until opendmx_group_stop is called on the associated opendmx_group.
+ */
+extern void *opendmx_group_thread (void *group);
+
+/**
+ *  Starts DMX output on every device in a group.
+ *  @note This function blocks the thread it is called on until output for the group is stoped. Devices in a running group can't be started on their own or closed.
+ *  @param group The group on which to output DMX.
+ *  @return 0 if output was stopped, < 0 if every device in the group failed or one of the devices is already outputting.
+ */
+extern int opendmx_group_start (opendmx_group *group);
+
+/**
+ *  Stops DMX output on a group.
+ *  @param group The group for which output is to be stopped.
+ */
+extern void opendmx_group_stop (opendmx_group *group);
+
+/**
+ *  Get the device whose universe is output by a group. Slots, effects and the other output settings for the group are set on this device.
+ *  @param group The group.
+ *  @returns The first device in the group.
+ */
+extern opendmx_device *opendmx_group_universe (const opendmx_group *group);
+
+/**
+ *  Check if a device in a group is still transmitting.
+ *  @param group The group.
+ *  @param port The index of the device in the group.
+ *  @returns 1 if the device is transmitting, 0 if it has failed or does not exist.
+ */
+extern int opendmx_group_port_ok (const opendmx_group *group, int port);
+
+/**
+ *  Get the primary device of a group, the first device which has not failed.
+ *  @param group The group.
+ *  @returns The index of the primary device in the group, -1 if every device has failed.
+ */
+extern int opendmx_group_primary (const opendmx_group *group);
+
+/**
+ *  Stops and frees a group. The devices in the group are not closed.
+ *  @param group The group to be freed.
+ */
+extern void opendmx_free_group (opendmx_group *group);
+
 /**
  *  Gets the value for a DMX slot.
  *  @param device The device to get the value from.
@@ -86,6 +239,160 @@ extern uint8_t opendmx_get_slot (const opendmx_device *device, int slot);
  */
 extern int opendmx_set_slot (opendmx_device *device, int slot, uint8_t value);
 
+/**
+ *  Get the values for a range of DMX slots.
+ *  @note On a shared universe the values are a consistent snapshot of the slots.
+ *  @param device The device to get the values from.
+ *  @param first_slot The first slot to get.
+ *  @param buffer The buffer in which to put the values.
+ *  @param count The number of slots to get.
+ *  @returns 0 if the values were copied, < 0 otherwise (ie. the slots do not exist)
+ */
+extern int opendmx_get_slots (const opendmx_device *device, int first_slot, uint8_t *buffer, int count);
+
+/**
+ *  Set the values for a range of DMX slots.
+ *  @note On a shared universe all of the values are written in a single update, they will always be transmitted in the same frame.
+ *  @param device The device in which to set the slots.
+ *  @param first_slot The first slot to be assigned a new value.
+ *  @param values The new values for the slots.
+ *  @param count The number of slots to set.
+ *  @returns 0 if the assignment was successful, < 0 otherwise (ie. the slots do not exist)
+ */
+extern int opendmx_set_slots (opendmx_device *device, int first_slot, const uint8_t *values, int count);
+
+/**
+ *  Begin writing directly to a device's slots. Must be paired with a call to opendmx_end_update.
+ *  @note On a shared universe everything written between opendmx_begin_update and opendmx_end_update is a single update, keep it short as the output loop waits for it to finish.
+ *  @param device The device in which to set slots.
+ *  @returns A pointer to the device's OPENDMX_UNIVERSE_LENGTH slots.
+ */
+extern uint8_t *opendmx_begin_update (opendmx_device *device);
+
+/**
+ *  Finish writing directly to a device's slots.
+ *  @param device The device passed to opendmx_begin_update.
+ */
+extern void opendmx_end_update (opendmx_device *device);
+
+/**
+ *  Move a device's universe into a POSIX shared memory segment so that other processes can write to it with opendmx_attach_universe.
+ *  @note The segment is removed when the device is closed.
+ *  @note Writes to a shared universe are serialized by a lock in the segment. If a process dies part way through a write the lock is recovered by the next process to write, or by the output loop. macOS has no robust mutexes, so there a process which dies between opendmx_begin_update and opendmx_end_update blocks later writes.
+ *  @param device The device whose universe should be shared.
+ *  @param name The name of the shared memory segment, must start with a '/' and must not already exist.
+ *  @returns 0 if the universe is now shared, < 0 otherwise.
+ */
+extern int opendmx_share_universe (opendmx_device *device, const char *name);
+
+/**
+ *  Attach to a universe shared by another process. The returned device is used with the normal slot functions, writes go directly to shared memory.
+ *  @note The returned device can not output DMX (opendmx_start fails), and the output stage (curves, effects, the frame hook and scheduled changes) can only be set up by the owner. It must be closed with opendmx_close_device.
+ *  @param name The name the universe was shared under.
+ *  @returns A device for the shared universe, or NULL if it could not be attached.
+ */
+extern opendmx_device *opendmx_attach_universe (const char *name);
+
+/**
+ *  Schedule new values for a range of DMX slots. The values are written to the slots just before the first frame which is due at or after the given time is built, all changes due by a frame are applied together.
+ *  @note Changes scheduled for the same time are applied in the order they were scheduled.
+ *  @param device The device in which to set the slots.
+ *  @param time The CLOCK_MONOTONIC time in nanoseconds at which the change should take effect.
+ *  @param first_slot The first slot to be assigned a new value.
+ *  @param values The new values for the slots, these are copied.
+ *  @param count The number of slots to set.
+ *  @returns 0 if the change was scheduled, < 0 otherwise (ie. the slots do not exist or the device is attached to another process's universe)
+ */
+extern int opendmx_schedule_slots (opendmx_device *device, uint64_t time, int first_slot, const uint8_t *values, int count);
+
+/**
+ *  Discard all scheduled changes which have not yet been applied.
+ *  @param device The device.
+ */
+extern void opendmx_clear_schedule (opendmx_device *device);
+
+/**
+ *  Set the response curve for a range of DMX slots. The curve is applied to the outgoing frame just before it is transmitted, the values stored in the slots are not affected.
+ *  @note Slots which share identical curves also share a single table, at most OPENDMX_MAX_CURVES distinct curves can be in use on a device at once.
+ *  @param device The device on which to set the curve.
+ *  @param first_slot The first slot which should use the curve.
+ *  @param count The number of slots which should use the curve.
+ *  @param curve A 256 entry lookup table mapping slot values to output values, or NULL to remove the curve from the slots.
+ *  @returns 0 if the curve was set, < 0 otherwise (ie. the slots do not exist, there are no free curves or the device is attached to another process's universe)
+ */
+extern int opendmx_set_curve (opendmx_device *device, int first_slot, int count, const uint8_t *curve);
+
+/**
+ *  Fill in a response curve which maps 0 to low and 255 to high following a power law.
+ *  @note A gamma of 1 gives a linear curve, swapping low and high gives an inverted curve.
+ *  @param curve The 256 entry lookup table to be filled.
+ *  @param gamma The exponent of the curve.
+ *  @param low The output value for a slot value of 0.
+ *  @param high The output value for a slot value of 255.
+ */
+extern void opendmx_curve_build (uint8_t *curve, double gamma, uint8_t low, uint8_t high);
+
+/**
+ *  Add an effect to a device. The effect is evaluated for every frame at the time the frame is sent and composed with the values of its slots. Effects are applied in the order they were added, before response curves.
+ *  @note The effect's cycle starts when it is added.
+ *  @param device The device to which the effect should be added.
+ *  @param effect The parameters for the effect, these are copied. To change an effect, remove it and add a new one.
+ *  @returns A handle for the effect, or NULL if the effect is not valid or the device is attached to another process's universe.
+ */
+extern opendmx_effect_handle *opendmx_add_effect (opendmx_device *device, const struct opendmx_effect *effect);
+
+/**
+ *  Remove an effect from a device.
+ *  @param device The device from which the effect should be removed.
+ *  @param effect The handle returned when the effect was added.
+ *  @returns 0 if the effect was removed, < 0 if the device does not have the effect.
+ */
+extern int opendmx_remove_effect (opendmx_device *device, opendmx_effect_handle *effect);
+
+/**
+ *  Render the frame which would be sent next, with effects and response curves applied, without transmitting it.
+ *  @param device The device for which the frame should be rendered.
+ *  @param buffer The buffer in which to put the frame, must be at least OPENDMX_UNIVERSE_LENGTH long.
+ */
+extern void opendmx_render_frame (opendmx_device *device, uint8_t *buffer);
+
+/**
+ *  Set a hook which is called before each frame is sent, for computing slot values as late as possible.
+ *  @note The hook runs on the thread which called opendmx_start. If it runs for longer than the lead time the frame will be late.
+ *  @note If the current hook is being called on another thread this waits for it to return, so once a hook has been replaced or removed it will not be called again and its context may be freed.
+ *  @param device The device for which to set the hook.
+ *  @param hook The hook, or NULL to remove the current hook.
+ *  @param context Passed to the hook.
+ *  @param lead_time The time in nanoseconds before each frame is due at which the hook is called.
+ *  @returns 0 if the hook was set, < 0 if the device is attached to another process's universe.
+ */
+extern int opendmx_set_frame_hook (opendmx_device *device, opendmx_frame_hook hook, void *context, long lead_time);
+
+/**
+ *  Wait for the next frame to be sent.
+ *  @note Any number of threads may wait for a frame at once, they are all woken when it is sent.
+ *  @param device The device to wait on.
+ *  @param timeout The maximum time to wait in nanoseconds, < 0 to wait indefinitely.
+ *  @param info If not NULL, the sequence number and timestamp of the frame are put here.
+ *  @returns 0 once a frame has been sent, < 0 if the timeout expired or output is not running. Returns straight away if output is not running.
+ */
+extern int opendmx_wait_frame (opendmx_device *device, long timeout, struct opendmx_frame_info *info);
+
+/**
+ *  Get a file descriptor which becomes readable after each frame is sent, for use with poll, select or epoll. Reading 8 bytes from it gives the number of frames sent since it was last read.
+ *  @note The file descriptor is owned by the device and is closed with it. Only available on Linux.
+ *  @param device The device.
+ *  @returns A non-blocking eventfd, or < 0 if it could not be created.
+ */
+extern int opendmx_frame_fd (opendmx_device *device);
+
+/**
+ *  Get output statistics for a device.
+ *  @param device The device.
+ *  @param stats The structure in which to put the statistics.
+ */
+extern void opendmx_get_stats (const opendmx_device *device, struct opendmx_stats *stats);
+
 /**
  *  Check if opendmx device is outputing DMX
  *  @returns 1 if DMX output is active, 0 otherwise.
@@ -99,6 +406,66 @@ extern int opendmx_is_running (opendmx_device *device);
  */
 extern int opendmx_has_error (opendmx_device *device);
 
+/**
+ *  Opens a serial device for DMX input.
+ *  @param device_file Path to the serial device to be used, must support 250k baud and report breaks. NULL creates an input which only receives bytes from opendmx_input_feed.
+ *  @returns A pointer to an opendmx_input, or NULL if the input could not be opened.
+ */
+extern opendmx_input *opendmx_open_input (const char *device_file);
+
+/**
+ *  A helper function designed to be used with a pthread. Calls opendmx_input_start.
+ *  @param input The input from which to receive DMX, must be an opendmx_input
+ *  @returns NULL, will not return until opendmx_input_stop is called on the associated opendmx_input.
+ */
+extern void *opendmx_input_thread (void *input);
+
+/**
+ *  Starts receiving DMX.
+ *  @note This function blocks the thread it is called on until the input is stopped.
+ *  @param input The input from which to receive DMX.
+ *  @return 0 if the input was stopped, < 0 if the input has no serial device, is already running or the serial device failed.
+ */
+extern int opendmx_input_start (opendmx_input *input);
+
+/**
+ *  Stops receiving DMX.
+ *  @param input The input which is to be stopped.
+ */
+extern void opendmx_input_stop (opendmx_input *input);
+
+/**
+ *  Closes and frees an opendmx input. The input is stopped first, this waits for the input loop to finish.
+ *  @param input The input to be closed.
+ */
+extern void opendmx_close_input (opendmx_input *input);
+
+/**
+ *  Parse bytes received from a serial port. This is called by opendmx_input_start, it can also be used to inject a stream of bytes into an input.
+ *  @note Bytes must be encoded as they would be by a POSIX serial port with PARMRK set. A break is 0xFF 0x00 0x00, a framing error is 0xFF 0x00 followed by the received byte, and a data byte of 0xFF is 0xFF 0xFF.
+ *  @param input The input which received the bytes.
+ *  @param bytes The received bytes.
+ *  @param length The number of bytes.
+ *  @returns 0
+ */
+extern int opendmx_input_feed (opendmx_input *input, const uint8_t *bytes, int length);
+
+/**
+ *  Get the oldest received frame which has not yet been read.
+ *  @note Only one thread may read frames from an input.
+ *  @param input The input to read from.
+ *  @param frame The frame in which to put the received frame.
+ *  @returns 0 if a frame was read, < 0 if there are no frames waiting.
+ */
+extern int opendmx_input_read_frame (opendmx_input *input, struct opendmx_input_frame *frame);
+
+/**
+ *  Get statistics for an input.
+ *  @param input The input.
+ *  @param stats The structure in which to put the statistics.
+ */
+extern void opendmx_input_get_stats (const opendmx_input *input, struct opendmx_input_stats *stats);
+
 /**
  *  Get a list of avaliable serial ports which could be used for DMX output. One macOS and Linux devices are referenced by device file name (ie. /dev/ttyUSB0). On Windows devices are referenced by serial number, and only FTDI serial devices will be listed.
  *  @note Devices listed are not nessasarly openDMX devices, and may not even support DMX output at all (the only real requirment is that the device supports 250kbaud and 72.8k baud)
@@ -142,4 +509,8 @@ int opendmx_iterator_to_array (const struct opendmx_iterator *iter, char **buffe
  */
 extern void opendmx_iterator_free (struct opendmx_iterator *iter);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* OpenDMX_h */
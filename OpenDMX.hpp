@@ -0,0 +1,369 @@
+//
+//  OpenDMX.hpp
+//  OpenDMX
+//
+//  Header only C++20 bindings for libOpenDMX. Handles are move only and own the C object they wrap, nothing in this file
+//  allocates and every member is inline, so using the bindings costs the same as calling the C API directly.
+//
+
+#ifndef OpenDMX_hpp
+#define OpenDMX_hpp
+
+#include "OpenDMX.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <utility>
+
+namespace opendmx {
+
+inline constexpr std::size_t universe_length = OPENDMX_UNIVERSE_LENGTH;
+
+using Slots = std::span<std::uint8_t, universe_length>;
+using ConstSlots = std::span<const std::uint8_t, universe_length>;
+
+// MARK: Patches
+/**
+ *  The slots used by a fixture, Count slots starting at First. A patch holds no state, its position is part of its type so
+ *  that writes through it are stores to a fixed offset in the universe and ranges are checked at compile time.
+ */
+template <std::size_t First, std::size_t Count>
+struct Patch {
+    static_assert(Count > 0, "A patch must cover at least one slot");
+    static_assert(First + Count <= universe_length, "A patch must fit in the universe");
+
+    static constexpr std::size_t first = First;
+    static constexpr std::size_t count = Count;
+
+    /**
+     *  @param slots A whole universe.
+     *  @returns The slots covered by the patch.
+     */
+    static constexpr std::span<std::uint8_t, Count> in (Slots slots) noexcept {
+        return slots.template subspan<First, Count>();
+    }
+
+    static constexpr std::span<const std::uint8_t, Count> in (ConstSlots slots) noexcept {
+        return slots.template subspan<First, Count>();
+    }
+
+    /**
+     *  @param slots A whole universe.
+     *  @returns A channel of the fixture, numbered from 0.
+     */
+    template <std::size_t Channel>
+    static constexpr std::uint8_t &channel (Slots slots) noexcept {
+        static_assert(Channel < Count, "Channel is outside of the patch");
+        return slots[First + Channel];
+    }
+};
+
+// MARK: Updates
+/**
+ *  Direct access to a device's slots between opendmx_begin_update and opendmx_end_update. The update is finished when the
+ *  Update goes out of scope, on a shared universe everything written in between is seen by the output as a single change.
+ *  An Update which is discarded straight away ends the update before anything is written, so it must be kept in a variable.
+ */
+class [[nodiscard]] Update {
+public:
+    explicit Update (opendmx_device *device) noexcept : device(device), slots_(opendmx_begin_update(device), universe_length) {}
+
+    ~Update () {
+        opendmx_end_update(device);
+    }
+
+    Update (const Update &) = delete;
+    Update &operator= (const Update &) = delete;
+
+    Slots slots () const noexcept {
+        return slots_;
+    }
+
+    std::uint8_t &operator[] (std::size_t slot) const noexcept {
+        return slots_[slot];
+    }
+
+    template <std::size_t First, std::size_t Count>
+    std::span<std::uint8_t, Count> operator[] (Patch<First, Count>) const noexcept {
+        return Patch<First, Count>::in(slots_);
+    }
+
+private:
+    opendmx_device  *device;
+    Slots           slots_;
+};
+
+// MARK: Devices
+/**
+ *  Owns an opendmx_device, which is closed when the Device is destroyed. Open failures leave the Device empty, check it
+ *  with operator bool before use. Methods other than close, release and reset must not be called on an empty Device.
+ */
+class Device {
+public:
+    Device () noexcept = default;
+
+    /**
+     *  Take ownership of a device from the C API.
+     */
+    explicit Device (opendmx_device *handle) noexcept : handle(handle) {}
+
+    /**
+     *  @see opendmx_open_device
+     */
+    static Device open (const char *device_file) noexcept {
+        return Device(opendmx_open_device(device_file));
+    }
+
+    /**
+     *  @see opendmx_attach_universe
+     */
+    static Device attach (const char *name) noexcept {
+        return Device(opendmx_attach_universe(name));
+    }
+
+    Device (Device &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+    Device &operator= (Device &&other) noexcept {
+        if (this != &other) {
+            reset(std::exchange(other.handle, nullptr));
+        }
+        return *this;
+    }
+
+    Device (const Device &) = delete;
+    Device &operator= (const Device &) = delete;
+
+    ~Device () {
+        reset();
+    }
+
+    explicit operator bool () const noexcept {
+        return handle != nullptr;
+    }
+
+    opendmx_device *get () const noexcept {
+        return handle;
+    }
+
+    /**
+     *  Give up ownership of the device without closing it.
+     *  @returns The device, which must now be closed with opendmx_close_device.
+     */
+    opendmx_device *release () noexcept {
+        return std::exchange(handle, nullptr);
+    }
+
+    /**
+     *  Close the current device, if any, and take ownership of another.
+     */
+    void reset (opendmx_device *other = nullptr) noexcept {
+        opendmx_device *old = std::exchange(handle, other);
+        if (old != nullptr) {
+            opendmx_close_device(old);
+        }
+    }
+
+    /**
+     *  Close the device now rather than when the Device is destroyed.
+     *  @returns 0 if successful, or the error returned by opendmx_close_device.
+     */
+    int close () noexcept {
+        return (handle != nullptr) ? opendmx_close_device(std::exchange(handle, nullptr)) : 0;
+    }
+
+    // Slots
+    std::uint8_t get_slot (int slot) const noexcept {
+        return opendmx_get_slot(handle, slot);
+    }
+
+    int set_slot (int slot, std::uint8_t value) noexcept {
+        return opendmx_set_slot(handle, slot, value);
+    }
+
+    /**
+     *  @see opendmx_get_slots
+     */
+    int read (int first_slot, std::span<std::uint8_t> buffer) const noexcept {
+        return opendmx_get_slots(handle, first_slot, buffer.data(), static_cast<int>(buffer.size()));
+    }
+
+    /**
+     *  @see opendmx_set_slots
+     */
+    int write (int first_slot, std::span<const std::uint8_t> values) noexcept {
+        return opendmx_set_slots(handle, first_slot, values.data(), static_cast<int>(values.size()));
+    }
+
+    template <std::size_t First, std::size_t Count>
+    int read (Patch<First, Count>, std::span<std::uint8_t, Count> buffer) const noexcept {
+        return opendmx_get_slots(handle, First, buffer.data(), Count);
+    }
+
+    template <std::size_t First, std::size_t Count>
+    int write (Patch<First, Count>, std::span<const std::uint8_t, Count> values) noexcept {
+        return opendmx_set_slots(handle, First, values.data(), Count);
+    }
+
+    /**
+     *  Start writing directly to the device's slots, see Update.
+     */
+    [[nodiscard]] Update update () noexcept {
+        return Update(handle);
+    }
+
+    /**
+     *  @see opendmx_share_universe
+     */
+    int share (const char *name) noexcept {
+        return opendmx_share_universe(handle, name);
+    }
+
+    // Output
+    /**
+     *  Run the output loop on the calling thread until stop is called, see opendmx_start.
+     */
+    int start () noexcept {
+        return opendmx_start(handle);
+    }
+
+    void stop () noexcept {
+        opendmx_stop(handle);
+    }
+
+    bool is_running () const noexcept {
+        return opendmx_is_running(handle);
+    }
+
+    bool has_error () const noexcept {
+        return opendmx_has_error(handle);
+    }
+
+    /**
+     *  @see opendmx_wait_frame
+     */
+    int wait_frame (long timeout, struct opendmx_frame_info *info = nullptr) noexcept {
+        return opendmx_wait_frame(handle, timeout, info);
+    }
+
+    struct opendmx_stats stats () const noexcept {
+        struct opendmx_stats stats;
+        opendmx_get_stats(handle, &stats);
+        return stats;
+    }
+
+private:
+    opendmx_device  *handle = nullptr;
+};
+
+// MARK: Device Enumeration
+/**
+ *  Owns an opendmx_iterator. Iteration is single pass, the names returned belong to the DeviceList and are freed with it.
+ */
+class DeviceList {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = const char *;
+        using difference_type = std::ptrdiff_t;
+
+        iterator () noexcept = default;
+
+        explicit iterator (struct opendmx_iterator *list) noexcept : list(list) {
+            ++*this;
+        }
+
+        const char *operator* () const noexcept {
+            return current;
+        }
+
+        iterator &operator++ () noexcept {
+            current = ((list != nullptr) && opendmx_iterator_has_next(list)) ? opendmx_iterator_next(list) : nullptr;
+            return *this;
+        }
+
+        void operator++ (int) noexcept {
+            ++*this;
+        }
+
+        bool operator== (std::default_sentinel_t) const noexcept {
+            return current == nullptr;
+        }
+
+    private:
+        struct opendmx_iterator *list = nullptr;
+        const char              *current = nullptr;
+    };
+
+    DeviceList () noexcept = default;
+
+    explicit DeviceList (struct opendmx_iterator *handle) noexcept : handle(handle) {}
+
+    /**
+     *  @see opendmx_get_devices
+     */
+    static DeviceList enumerate () noexcept {
+        return DeviceList(opendmx_get_devices());
+    }
+
+    DeviceList (DeviceList &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+    DeviceList &operator= (DeviceList &&other) noexcept {
+        if (this != &other) {
+            free();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    DeviceList (const DeviceList &) = delete;
+    DeviceList &operator= (const DeviceList &) = delete;
+
+    ~DeviceList () {
+        free();
+    }
+
+    explicit operator bool () const noexcept {
+        return handle != nullptr;
+    }
+
+    struct opendmx_iterator *get () const noexcept {
+        return handle;
+    }
+
+    /**
+     *  @returns The total number of devices found.
+     */
+    int size () const noexcept {
+        return (handle != nullptr) ? opendmx_iterator_length(handle) : 0;
+    }
+
+    /**
+     *  @returns An iterator over the devices which have not yet been visited.
+     */
+    iterator begin () noexcept {
+        return iterator(handle);
+    }
+
+    std::default_sentinel_t end () const noexcept {
+        return std::default_sentinel;
+    }
+
+private:
+    void free () noexcept {
+        if (handle != nullptr) {
+            opendmx_iterator_free(handle);
+        }
+    }
+
+    struct opendmx_iterator *handle = nullptr;
+};
+
+static_assert(std::input_iterator<DeviceList::iterator>);
+static_assert(std::sentinel_for<std::default_sentinel_t, DeviceList::iterator>);
+
+} // namespace opendmx
+
+#endif /* OpenDMX_hpp */
@@ -0,0 +1,37 @@
+//
+//  Test.h
+//  OpenDMX
+//
+//  A minimal check macro shared by the tests. Failed checks are reported with their location and the test exits non-zero.
+//
+
+#ifndef Test_h
+#define Test_h
+
+#include <stdio.h>
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static int checks;
+static int failures;
+
+static int check (int passed, const char *text, const char *file, int line) {
+    checks++;
+    if (!passed) {
+        failures++;
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, text);
+    }
+    return passed;
+}
+
+/**
+ *  Print a summary of the checks which have been made.
+ *  @param name The name of the test.
+ *  @returns The exit status for the test, 0 if every check passed.
+ */
+static int test_finish (const char *name) {
+    printf("%s: %d checks, %d failed\n", name, checks, failures);
+    return failures != 0;
+}
+
+#endif /* Test_h */
@@ -0,0 +1,93 @@
+//
+//  TestCurves.c
+//  OpenDMX
+//
+//  Checks how response curves share and reuse their tables, by rendering frames on the virtual backend.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "../OpenDMX.h"
+#include "Test.h"
+
+#include <string.h>
+
+#define SLOT_VALUE  0x10
+
+static uint8_t curves[OPENDMX_MAX_CURVES + 3][256];
+
+/**
+ *  Check a range of slots in a rendered frame against a curve.
+ *  @param curve The curve expected, or NULL if the slots should be sent as they are.
+ */
+static void check_slots (const uint8_t *frame, int first_slot, int count, const uint8_t *curve) {
+    const uint8_t expected = (curve != NULL) ? curve[SLOT_VALUE] : SLOT_VALUE;
+    for (int i = first_slot; i < first_slot + count; i++) {
+        if (!CHECK(frame[i] == expected)) return;
+    }
+}
+
+int main (int argc, char **argv) {
+    // Distinct curves which are not the identity
+    for (int c = 0; c < OPENDMX_MAX_CURVES + 3; c++) {
+        for (int v = 0; v < 256; v++) {
+            curves[c][v] = (uint8_t)(v ^ (c + 1));
+        }
+    }
+    uint8_t identity[256];
+    for (int v = 0; v < 256; v++) {
+        identity[v] = (uint8_t)v;
+    }
+    opendmx_device *device = opendmx_open_device("virtual");
+    if (!CHECK(device != NULL)) {
+        return test_finish("test_curves");
+    }
+    uint8_t frame[OPENDMX_UNIVERSE_LENGTH];
+    uint8_t slots[OPENDMX_UNIVERSE_LENGTH];
+    memset(slots, SLOT_VALUE, sizeof(slots));
+    CHECK(opendmx_set_slots(device, 0, slots, OPENDMX_UNIVERSE_LENGTH) == 0);
+    
+    // Every table in use, identical curves on more slots share them
+    const int used = OPENDMX_MAX_CURVES;
+    for (int c = 0; c < used; c++) {
+        CHECK(opendmx_set_curve(device, c, 1, curves[c]) == 0);
+        CHECK(opendmx_set_curve(device, used + c, 1, curves[c]) == 0);
+    }
+    CHECK(opendmx_set_curve(device, 2 * used, 1, curves[used]) < 0);    // One distinct curve too many
+    opendmx_render_frame(device, frame);
+    for (int c = 0; c < used; c++) {
+        check_slots(frame, c, 1, curves[c]);
+        check_slots(frame, used + c, 1, curves[c]);
+    }
+    check_slots(frame, 2 * used, OPENDMX_UNIVERSE_LENGTH - 2 * used, NULL);
+    CHECK(opendmx_get_slot(device, 0) == SLOT_VALUE);  // Curves only change the frame sent
+    
+    // Reassigning part of a curve's slots doesn't free its table, reassigning all of them does
+    CHECK(opendmx_set_curve(device, 0, 1, curves[used]) < 0);
+    CHECK(opendmx_set_curve(device, 0, used + 1, curves[used]) == 0);
+    opendmx_render_frame(device, frame);
+    check_slots(frame, 0, used + 1, curves[used]);
+    for (int c = 1; c < used; c++) {
+        check_slots(frame, used + c, 1, curves[c]);
+    }
+    
+    // Removing a curve, or setting the identity, frees its table
+    CHECK(opendmx_set_curve(device, used + 1, 1, NULL) == 0);
+    CHECK(opendmx_set_curve(device, used + 2, 1, identity) == 0);
+    CHECK(opendmx_set_curve(device, 2 * used, 1, curves[used + 1]) == 0);
+    CHECK(opendmx_set_curve(device, 2 * used + 1, 1, curves[used + 2]) == 0);
+    CHECK(opendmx_set_curve(device, 2 * used + 2, 1, curves[0]) < 0);
+    opendmx_render_frame(device, frame);
+    check_slots(frame, used + 1, 2, NULL);
+    check_slots(frame, 2 * used, 1, curves[used + 1]);
+    check_slots(frame, 2 * used + 1, 1, curves[used + 2]);
+    
+    // Clearing every slot leaves the frame as it is stored
+    CHECK(opendmx_set_curve(device, 0, OPENDMX_UNIVERSE_LENGTH, NULL) == 0);
+    opendmx_render_frame(device, frame);
+    check_slots(frame, 0, OPENDMX_UNIVERSE_LENGTH, NULL);
+    CHECK(opendmx_set_curve(device, OPENDMX_UNIVERSE_LENGTH - 1, 2, curves[0]) < 0);
+    
+    CHECK(opendmx_close_device(device) == 0);
+    return test_finish("test_curves");
+}
@@ -0,0 +1,135 @@
+//
+//  TestEffects.c
+//  OpenDMX
+//
+//  Checks effect waveforms and how they are composed with the universe, by rendering frames on the virtual backend.
+//  Effects use a period far longer than the test so that their phase is fixed at the one they were given.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "../OpenDMX.h"
+#include "Test.h"
+
+#include <string.h>
+
+#define SLOT_VALUE  100
+#define FIXED_PERIOD 1000000000000000LL
+
+static opendmx_device *device;
+
+/**
+ *  Render a frame with a single effect applied.
+ */
+static void render_effect (const struct opendmx_effect *effect, uint8_t *frame) {
+    opendmx_effect_handle *handle = opendmx_add_effect(device, effect);
+    if (!CHECK(handle != NULL)) return;
+    opendmx_render_frame(device, frame);
+    CHECK(opendmx_remove_effect(device, handle) == 0);
+}
+
+/**
+ *  An effect with one cycle of its waveform spread across the first 256 slots, so that slot i shows entry i of the table.
+ */
+static struct opendmx_effect whole_cycle (enum opendmx_waveform waveform, uint8_t low, uint8_t high) {
+    struct opendmx_effect effect = { waveform, OPENDMX_COMPOSE_REPLACE, 0, 256, FIXED_PERIOD, 0, 256, 0, low, high };
+    return effect;
+}
+
+/**
+ *  A saw wave held at one value, for checking how effects are composed.
+ */
+static struct opendmx_effect constant (enum opendmx_compose compose, int first_slot, int count, uint8_t value) {
+    struct opendmx_effect effect = { OPENDMX_WAVE_SAW, compose, first_slot, count, FIXED_PERIOD, value << 8, 0, 0, 0, 255 };
+    return effect;
+}
+
+static void test_waveforms (void) {
+    uint8_t frame[OPENDMX_UNIVERSE_LENGTH];
+    
+    // Triangle rises for half a cycle then falls back along the same values
+    struct opendmx_effect effect = whole_cycle(OPENDMX_WAVE_TRIANGLE, 0, 255);
+    render_effect(&effect, frame);
+    CHECK((frame[0] == 0) && (frame[127] == 254) && (frame[128] == 255) && (frame[255] == 1));
+    for (int i = 0; i < 128; i++) {
+        CHECK(frame[255 - i] - frame[i] == 1);
+        CHECK((i == 0) || (frame[i] > frame[i - 1]));
+    }
+    
+    // Square is high for the duty cycle
+    effect = whole_cycle(OPENDMX_WAVE_SQUARE, 10, 240);
+    effect.duty = 16384;
+    render_effect(&effect, frame);
+    int high = 0;
+    for (int i = 0; i < 256; i++) {
+        CHECK((frame[i] == 240) || (frame[i] == 10));
+        high += (frame[i] == 240);
+    }
+    CHECK(high == 64);
+    CHECK((frame[63] == 240) && (frame[64] == 10));
+    
+    // A range with high below low inverts the waveform
+    effect = whole_cycle(OPENDMX_WAVE_SAW, 200, 50);
+    render_effect(&effect, frame);
+    CHECK((frame[0] == 200) && (frame[255] == 50));
+    for (int i = 1; i < 256; i++) {
+        CHECK(frame[i] <= frame[i - 1]);
+    }
+    
+    // Sine at known phases, a quarter cycle is half way up
+    effect = (struct opendmx_effect){ OPENDMX_WAVE_SINE, OPENDMX_COMPOSE_REPLACE, 300, 4, FIXED_PERIOD, 0, 16384, 0, 0, 255 };
+    render_effect(&effect, frame);
+    CHECK((frame[300] == 0) && (frame[302] == 255));
+    CHECK((frame[301] >= 127) && (frame[301] <= 128) && (frame[303] >= 127) && (frame[303] <= 128));
+    
+    // The slots outside of an effect are left alone
+    CHECK((frame[299] == SLOT_VALUE) && (frame[304] == SLOT_VALUE));
+}
+
+static void test_compose (void) {
+    uint8_t frame[OPENDMX_UNIVERSE_LENGTH];
+    opendmx_effect_handle *effects[7];
+    const struct opendmx_effect specs[7] = {
+        constant(OPENDMX_COMPOSE_REPLACE, 0, 8, 30),
+        constant(OPENDMX_COMPOSE_ADD, 8, 8, 50),
+        constant(OPENDMX_COMPOSE_ADD, 16, 8, 200),     // Saturates
+        constant(OPENDMX_COMPOSE_MAX, 24, 8, 50),
+        constant(OPENDMX_COMPOSE_MAX, 32, 8, 200),
+        // Effects are applied in the order they were added
+        constant(OPENDMX_COMPOSE_REPLACE, 40, 8, 30),
+        constant(OPENDMX_COMPOSE_ADD, 40, 8, 40),
+    };
+    for (int i = 0; i < 7; i++) {
+        effects[i] = opendmx_add_effect(device, &specs[i]);
+        CHECK(effects[i] != NULL);
+    }
+    opendmx_render_frame(device, frame);
+    const uint8_t expected[6] = { 30, SLOT_VALUE + 50, 255, SLOT_VALUE, 200, 70 };
+    for (int i = 0; i < 48; i++) {
+        CHECK(frame[i] == expected[i / 8]);
+    }
+    CHECK(frame[48] == SLOT_VALUE);
+    CHECK(opendmx_get_slot(device, 0) == SLOT_VALUE);  // Effects only change the frame sent
+    
+    for (int i = 0; i < 7; i++) {
+        CHECK(opendmx_remove_effect(device, effects[i]) == 0);
+    }
+    opendmx_render_frame(device, frame);
+    CHECK((frame[0] == SLOT_VALUE) && (frame[40] == SLOT_VALUE));
+}
+
+int main (int argc, char **argv) {
+    device = opendmx_open_device("virtual");
+    if (!CHECK(device != NULL)) {
+        return test_finish("test_effects");
+    }
+    uint8_t slots[OPENDMX_UNIVERSE_LENGTH];
+    memset(slots, SLOT_VALUE, sizeof(slots));
+    CHECK(opendmx_set_slots(device, 0, slots, OPENDMX_UNIVERSE_LENGTH) == 0);
+    
+    test_waveforms();
+    test_compose();
+    
+    CHECK(opendmx_close_device(device) == 0);
+    return test_finish("test_effects");
+}
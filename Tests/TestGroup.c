@@ -0,0 +1,139 @@
+//
+//  TestGroup.c
+//  OpenDMX
+//
+//  Checks failover in output groups, using the D2XX backend on the stub in ftd2xx/ to make devices stall or fail part way through.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "../OpenDMX.h"
+#include "ftd2xx.h"
+#include "Test.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define FRAME_TIME  (OPENDMX_PACKET_TIME + OPENDMX_PERIOD_HIGH)
+#define TEST_FRAMES 20
+
+struct group_thread {
+    opendmx_group   *group;
+    int             result;
+};
+
+static void *run_group (void *context) {
+    struct group_thread *thread = context;
+    thread->result = opendmx_group_start(thread->group);
+    return NULL;
+}
+
+/**
+ *  Wait for frames and check that none of them were skipped.
+ *  @returns The number of frames received.
+ */
+static int wait_frames (opendmx_device *device, int count) {
+    struct opendmx_frame_info frame, last = { 0, 0 };
+    int received = 0;
+    while ((received < count) && (opendmx_wait_frame(device, 4 * FRAME_TIME, &frame) == 0)) {
+        if (received > 0) {
+            CHECK(frame.sequence == last.sequence + 1);
+            CHECK(frame.timestamp - last.timestamp < 2 * FRAME_TIME);
+        }
+        last = frame;
+        received++;
+    }
+    return received;
+}
+
+static uint64_t monotonic_time (void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+static void test_stall (opendmx_device **devices) {
+    opendmx_group *group = opendmx_create_group(devices, 2);
+    struct group_thread thread = { group, 0 };
+    pthread_t pthread;
+    pthread_create(&pthread, NULL, run_group, &thread);
+    while (!opendmx_is_running(devices[0])) {
+        sched_yield();
+    }
+    CHECK(wait_frames(devices[0], 5) == 5);
+    
+    // The first device stops responding, its writes block for longer than it takes to drop it. Frames carry on at the
+    // normal rate on the second device while it is blocked, and it is dropped after 8 frames without a completed write.
+    ftd2xx_stub_set_stalling("STUB0", 12 * FRAME_TIME);
+    const unsigned long writes = ftd2xx_stub_device_writes("STUB1");
+    const uint64_t start = monotonic_time();
+    CHECK(wait_frames(devices[0], TEST_FRAMES) == TEST_FRAMES);
+    CHECK(monotonic_time() - start < (TEST_FRAMES + 2) * FRAME_TIME);
+    CHECK(ftd2xx_stub_device_writes("STUB1") - writes >= TEST_FRAMES);
+    CHECK(opendmx_group_primary(group) == 1);
+    CHECK(!opendmx_group_port_ok(group, 0));
+    CHECK(!opendmx_has_error(devices[0]));
+    
+    // Stopping waits for the stalled write to finish
+    opendmx_group_stop(group);
+    pthread_join(pthread, NULL);
+    CHECK(thread.result == 0);
+    opendmx_free_group(group);
+    ftd2xx_stub_set_stalling("STUB0", 0);
+}
+
+static void test_failover (opendmx_device **devices) {
+    opendmx_group *group = opendmx_create_group(devices, 2);
+    struct group_thread thread = { group, 0 };
+    pthread_t pthread;
+    pthread_create(&pthread, NULL, run_group, &thread);
+    while (!opendmx_is_running(devices[0])) {
+        sched_yield();
+    }
+    
+    // Both devices send every frame
+    CHECK(wait_frames(devices[0], 5) == 5);
+    CHECK(ftd2xx_stub_device_writes("STUB0") > 0);
+    CHECK(ftd2xx_stub_device_writes("STUB1") > 0);
+    CHECK(opendmx_group_primary(group) == 0);
+    CHECK(opendmx_close_device(devices[1]) != 0);   // Still in use by the group
+    CHECK(opendmx_start(devices[1]) < 0);
+    
+    // The first device fails, frames carry on without a gap on the second
+    ftd2xx_stub_set_failing("STUB0", 1);
+    const unsigned long writes = ftd2xx_stub_device_writes("STUB1");
+    CHECK(wait_frames(devices[0], TEST_FRAMES) == TEST_FRAMES);
+    CHECK(ftd2xx_stub_device_writes("STUB1") - writes >= TEST_FRAMES);
+    CHECK(opendmx_group_primary(group) == 1);
+    CHECK(!opendmx_group_port_ok(group, 0));
+    CHECK(opendmx_group_port_ok(group, 1));
+    CHECK(opendmx_is_running(devices[0]));
+    CHECK(!opendmx_has_error(devices[0]));
+    
+    // Output stops with an error once the second device fails too
+    ftd2xx_stub_set_failing("STUB1", 1);
+    CHECK(wait_frames(devices[0], TEST_FRAMES) < TEST_FRAMES);
+    pthread_join(pthread, NULL);
+    CHECK(thread.result < 0);
+    CHECK(!opendmx_is_running(devices[0]));
+    CHECK(opendmx_has_error(devices[0]));
+    CHECK(opendmx_group_primary(group) == -1);
+    
+    opendmx_free_group(group);
+    ftd2xx_stub_set_failing("STUB0", 0);
+    ftd2xx_stub_set_failing("STUB1", 0);
+}
+
+int main (int argc, char **argv) {
+    opendmx_interpacket_time = OPENDMX_PERIOD_HIGH;
+    opendmx_device *devices[2] = { opendmx_open_device("STUB0"), opendmx_open_device("STUB1") };
+    if (!CHECK((devices[0] != NULL) && (devices[1] != NULL))) {
+        return test_finish("test_group");
+    }
+    test_stall(devices);
+    test_failover(devices);
+    CHECK(opendmx_close_device(devices[1]) == 0);
+    CHECK(opendmx_close_device(devices[0]) == 0);
+    return test_finish("test_group");
+}
@@ -0,0 +1,75 @@
+//
+//  TestHook.c
+//  OpenDMX
+//
+//  Checks that a frame hook is never called after it has been removed, using the virtual backend.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "../OpenDMX.h"
+#include "Test.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define FRAME_TIME  (OPENDMX_PACKET_TIME + OPENDMX_PERIOD_HIGH)
+#define TEST_ROUNDS 20
+
+struct hook_context {
+    volatile int    calls;
+    volatile int    inside;     // Set while the hook is running
+    volatile int    freed;      // Set once the hook has been removed, the hook must not run after this
+    volatile int    late_calls;
+};
+
+static void slow_hook (opendmx_device *device, uint8_t *frame, uint64_t deadline, void *context) {
+    struct hook_context *hook = context;
+    if (hook->freed) {
+        hook->late_calls++;
+    }
+    hook->inside = 1;
+    const struct timespec delay = { 0, 2000000 };
+    nanosleep(&delay, NULL);
+    frame[0] = (uint8_t)++hook->calls;
+    hook->inside = 0;
+}
+
+static void *run_output (void *device) {
+    opendmx_start(device);
+    return NULL;
+}
+
+int main (int argc, char **argv) {
+    opendmx_interpacket_time = OPENDMX_PERIOD_HIGH;
+    opendmx_device *device = opendmx_open_device("virtual");
+    if (!CHECK(device != NULL)) {
+        return test_finish("test_hook");
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_output, device);
+    while (!opendmx_is_running(device)) {
+        sched_yield();
+    }
+    
+    // Remove the hook while it is running, it must have returned by the time opendmx_set_frame_hook does
+    for (int round = 0; round < TEST_ROUNDS; round++) {
+        struct hook_context context = { 0, 0, 0, 0 };
+        CHECK(opendmx_set_frame_hook(device, slow_hook, &context, 4000000) == 0);
+        while (!context.inside) {
+            sched_yield();
+        }
+        CHECK(opendmx_set_frame_hook(device, NULL, NULL, 0) == 0);
+        CHECK(!context.inside);
+        context.freed = 1;
+        CHECK(opendmx_wait_frame(device, 4 * FRAME_TIME, NULL) == 0);
+        CHECK(opendmx_wait_frame(device, 4 * FRAME_TIME, NULL) == 0);
+        CHECK(context.late_calls == 0);
+    }
+    
+    opendmx_stop(device);
+    pthread_join(thread, NULL);
+    CHECK(opendmx_close_device(device) == 0);
+    return test_finish("test_hook");
+}
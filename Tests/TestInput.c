@@ -0,0 +1,202 @@
+//
+//  TestInput.c
+//  OpenDMX
+//
+//  Checks the DMX input parser by feeding it streams as the serial driver delivers them with PARMRK set: a break is
+//  0xFF 0x00 0x00, a framing error is 0xFF 0x00 followed by the byte received, and a data byte of 0xFF is doubled.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "../OpenDMX.h"
+#include "Test.h"
+
+#include <string.h>
+#include <time.h>
+
+static void feed (opendmx_input *input, const uint8_t *bytes, int length) {
+    opendmx_input_feed(input, bytes, length);
+}
+
+static void feed_break (opendmx_input *input) {
+    const uint8_t mark[3] = { 0xFF, 0x00, 0x00 };
+    feed(input, mark, 3);
+}
+
+static void feed_framing_error (opendmx_input *input, uint8_t byte) {
+    const uint8_t mark[3] = { 0xFF, 0x00, byte };
+    feed(input, mark, 3);
+}
+
+static void feed_byte (opendmx_input *input, uint8_t byte) {
+    const uint8_t escaped[2] = { 0xFF, 0xFF };
+    feed(input, (byte == 0xFF) ? escaped : &byte, (byte == 0xFF) ? 2 : 1);
+}
+
+/**
+ *  Feed a break, a start code and some slots.
+ */
+static void feed_frame (opendmx_input *input, uint8_t start_code, const uint8_t *slots, int count) {
+    feed_break(input);
+    feed_byte(input, start_code);
+    for (int i = 0; i < count; i++) {
+        feed_byte(input, slots[i]);
+    }
+}
+
+static void test_escaped_data (void) {
+    opendmx_input *input = opendmx_open_input(NULL);
+    struct opendmx_input_frame frame;
+    struct opendmx_input_stats stats;
+    
+    // Bytes before the first break are not part of a frame
+    const uint8_t noise[3] = { 1, 2, 3 };
+    feed(input, noise, 3);
+    const uint8_t slots[4] = { 0x01, 0xFF, 0x00, 0xFF };
+    feed_frame(input, 0xCC, slots, 4);
+    CHECK(opendmx_input_read_frame(input, &frame) < 0);     // Not complete until the next break
+    feed_break(input);
+    CHECK(opendmx_input_read_frame(input, &frame) == 0);
+    CHECK(frame.start_code == 0xCC);
+    CHECK(frame.length == 4);
+    CHECK(memcmp(frame.slots, slots, 4) == 0);
+    CHECK(opendmx_input_read_frame(input, &frame) < 0);
+    
+    opendmx_input_get_stats(input, &stats);
+    CHECK(stats.frames == 1);
+    CHECK(stats.breaks == 2);
+    CHECK(stats.framing_errors == 0);
+    opendmx_close_input(input);
+}
+
+static void test_split_marks (void) {
+    // A break or an escaped 0xFF may be split between reads
+    opendmx_input *input = opendmx_open_input(NULL);
+    struct opendmx_input_frame frame;
+    const uint8_t stream[] = { 0xFF, 0x00, 0x00, 0x00, 0x10, 0xFF, 0xFF, 0x20, 0xFF, 0x00, 0x00 };
+    for (int i = 0; i < (int)sizeof(stream); i++) {
+        feed(input, &stream[i], 1);
+    }
+    CHECK(opendmx_input_read_frame(input, &frame) == 0);
+    CHECK(frame.start_code == 0x00);
+    CHECK(frame.length == 3);
+    CHECK((frame.slots[0] == 0x10) && (frame.slots[1] == 0xFF) && (frame.slots[2] == 0x20));
+    opendmx_close_input(input);
+}
+
+static void test_framing_error (void) {
+    opendmx_input *input = opendmx_open_input(NULL);
+    struct opendmx_input_frame frame;
+    struct opendmx_input_stats stats;
+    
+    // The frame in progress is discarded, and so is everything up to the next break
+    const uint8_t bad[2] = { 1, 2 };
+    feed_frame(input, 0x00, bad, 2);
+    feed_framing_error(input, 0x05);
+    feed(input, bad, 2);
+    const uint8_t good[1] = { 9 };
+    feed_frame(input, 0x00, good, 1);
+    feed_break(input);
+    
+    CHECK(opendmx_input_read_frame(input, &frame) == 0);
+    CHECK(frame.length == 1);
+    CHECK(frame.slots[0] == 9);
+    CHECK(opendmx_input_read_frame(input, &frame) < 0);
+    opendmx_input_get_stats(input, &stats);
+    CHECK(stats.frames == 1);
+    CHECK(stats.framing_errors == 1);
+    opendmx_close_input(input);
+}
+
+static void test_full_universe (void) {
+    opendmx_input *input = opendmx_open_input(NULL);
+    struct opendmx_input_frame frame;
+    uint8_t slots[OPENDMX_UNIVERSE_LENGTH];
+    for (int i = 0; i < OPENDMX_UNIVERSE_LENGTH; i++) {
+        slots[i] = (uint8_t)(i * 7);
+    }
+    
+    // A whole universe is complete as soon as its last slot arrives, anything after it is ignored until the next break
+    feed_frame(input, 0x00, slots, OPENDMX_UNIVERSE_LENGTH);
+    CHECK(opendmx_input_read_frame(input, &frame) == 0);
+    CHECK(frame.length == OPENDMX_UNIVERSE_LENGTH);
+    CHECK(memcmp(frame.slots, slots, OPENDMX_UNIVERSE_LENGTH) == 0);
+    feed(input, slots, 10);
+    feed_break(input);
+    CHECK(opendmx_input_read_frame(input, &frame) < 0);
+    opendmx_close_input(input);
+}
+
+static void test_full_ring (void) {
+    opendmx_input *input = opendmx_open_input(NULL);
+    struct opendmx_input_frame frame;
+    struct opendmx_input_stats stats;
+    const int sent = OPENDMX_INPUT_RING_LENGTH + 4;
+    
+    // Frames which arrive while the ring is full are dropped, the oldest frames are kept
+    for (int i = 0; i < sent; i++) {
+        const uint8_t slot = (uint8_t)i;
+        feed_frame(input, 0x00, &slot, 1);
+    }
+    feed_break(input);
+    opendmx_input_get_stats(input, &stats);
+    CHECK(stats.frames == sent);
+    CHECK(stats.dropped_frames == sent - OPENDMX_INPUT_RING_LENGTH);
+    for (int i = 0; i < OPENDMX_INPUT_RING_LENGTH; i++) {
+        CHECK(opendmx_input_read_frame(input, &frame) == 0);
+        CHECK(frame.slots[0] == i);
+    }
+    CHECK(opendmx_input_read_frame(input, &frame) < 0);
+    
+    // Reading makes room again
+    const uint8_t slot = 0xAA;
+    feed_frame(input, 0x00, &slot, 1);
+    feed_break(input);
+    CHECK(opendmx_input_read_frame(input, &frame) == 0);
+    CHECK(frame.slots[0] == 0xAA);
+    opendmx_close_input(input);
+}
+
+static void test_frame_rate (void) {
+    opendmx_input *input = opendmx_open_input(NULL);
+    struct opendmx_input_stats stats;
+    const struct timespec frame_time = { 0, 10000000 };
+    const uint8_t slot = 0;
+    
+    // Frames at 100fps for just over a second
+    for (int i = 0; i < 105; i++) {
+        feed_frame(input, 0x00, &slot, 1);
+        nanosleep(&frame_time, NULL);
+    }
+    feed_break(input);
+    opendmx_input_get_stats(input, &stats);
+    CHECK((stats.frame_rate > 50) && (stats.frame_rate <= 100));
+    
+    // Once the feed stops the rate falls instead of holding its last value
+    const struct timespec pause = { 1, 100000000 };
+    nanosleep(&pause, NULL);
+    opendmx_input_get_stats(input, &stats);
+    CHECK(stats.frame_rate < 10);
+    opendmx_close_input(input);
+}
+
+static void test_start_without_port (void) {
+    opendmx_input *input = opendmx_open_input(NULL);
+    
+    // An input without a serial port has nothing to read, starting it fails without leaving it marked as running
+    CHECK(opendmx_input_start(input) < 0);
+    CHECK(opendmx_input_start(input) < 0);
+    opendmx_input_stop(input);
+    opendmx_close_input(input);
+}
+
+int main (int argc, char **argv) {
+    test_escaped_data();
+    test_split_marks();
+    test_framing_error();
+    test_full_universe();
+    test_full_ring();
+    test_frame_rate();
+    test_start_without_port();
+    return test_finish("test_input");
+}
@@ -0,0 +1,115 @@
+//
+//  TestSchedule.c
+//  OpenDMX
+//
+//  Checks that scheduled changes are applied in time order, and in the order they were scheduled when they are due at the
+//  same time, by recording the frames the output loop builds on the virtual backend.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "../OpenDMX.h"
+#include "Test.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define FRAME_TIME  (OPENDMX_PACKET_TIME + OPENDMX_PERIOD_HIGH)
+#define MAX_FRAMES  64
+
+struct recorded_frame {
+    uint64_t    deadline;
+    uint8_t     slots[4];
+};
+
+struct recording {
+    struct recorded_frame   frames[MAX_FRAMES];
+    volatile int            length;
+};
+
+static void record_frame (opendmx_device *device, uint8_t *frame, uint64_t deadline, void *context) {
+    struct recording *recording = context;
+    if (recording->length == MAX_FRAMES) return;
+    struct recorded_frame *record = &recording->frames[recording->length];
+    record->deadline = deadline;
+    for (int i = 0; i < 4; i++) {
+        record->slots[i] = frame[i];
+    }
+    recording->length++;
+}
+
+static void *run_output (void *device) {
+    opendmx_start(device);
+    return NULL;
+}
+
+static uint64_t monotonic_time (void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+static int schedule_slot (opendmx_device *device, uint64_t time, int slot, uint8_t value) {
+    return opendmx_schedule_slots(device, time, slot, &value, 1);
+}
+
+int main (int argc, char **argv) {
+    opendmx_interpacket_time = OPENDMX_PERIOD_HIGH;
+    opendmx_device *device = opendmx_open_device("virtual");
+    if (!CHECK(device != NULL)) {
+        return test_finish("test_schedule");
+    }
+    static struct recording recording;
+    CHECK(opendmx_set_frame_hook(device, record_frame, &recording, 0) == 0);
+    const uint64_t base = monotonic_time() + 4 * FRAME_TIME;
+    
+    // Cleared changes are never applied
+    CHECK(schedule_slot(device, base + FRAME_TIME, 0, 99) == 0);
+    CHECK(schedule_slot(device, base + FRAME_TIME, 3, 77) == 0);
+    opendmx_clear_schedule(device);
+    
+    // Out of order, each is applied from the first frame due at or after its time
+    CHECK(schedule_slot(device, base + 6 * FRAME_TIME, 0, 30) == 0);
+    CHECK(schedule_slot(device, base + 2 * FRAME_TIME, 0, 10) == 0);
+    CHECK(schedule_slot(device, base + 4 * FRAME_TIME, 0, 20) == 0);
+    // At the same time, the last one scheduled wins where they overlap
+    const uint8_t pair[2] = { 5, 5 };
+    CHECK(schedule_slot(device, base + 3 * FRAME_TIME, 1, 1) == 0);
+    CHECK(opendmx_schedule_slots(device, base + 3 * FRAME_TIME, 1, pair, 2) == 0);
+    CHECK(schedule_slot(device, base + 3 * FRAME_TIME, 2, 9) == 0);
+    CHECK(schedule_slot(device, base + 3 * FRAME_TIME, 1, 2) == 0);
+    CHECK(opendmx_schedule_slots(device, base, 510, pair, 3) < 0);
+    
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_output, device);
+    while ((recording.length < MAX_FRAMES) &&
+           ((recording.length == 0) || (recording.frames[recording.length - 1].deadline < base + 8 * FRAME_TIME))) {
+        opendmx_wait_frame(device, 4 * FRAME_TIME, NULL);
+    }
+    opendmx_stop(device);
+    pthread_join(thread, NULL);
+    
+    int changes_seen = 0;
+    for (int i = 0; i < recording.length; i++) {
+        const struct recorded_frame *frame = &recording.frames[i];
+        const uint64_t time = frame->deadline - base;
+        const uint8_t expected = (frame->deadline < base + 2 * FRAME_TIME) ? 0 :
+                                 (time < 4 * FRAME_TIME) ? 10 : (time < 6 * FRAME_TIME) ? 20 : 30;
+        const int same_time_due = frame->deadline >= base + 3 * FRAME_TIME;
+        CHECK(frame->slots[0] == expected);
+        CHECK(frame->slots[1] == (same_time_due ? 2 : 0));
+        CHECK(frame->slots[2] == (same_time_due ? 9 : 0));
+        CHECK(frame->slots[3] == 0);
+        changes_seen += (frame->slots[0] != 0);
+    }
+    CHECK(changes_seen > 0);
+    CHECK(opendmx_get_slot(device, 0) == 30);
+    CHECK(opendmx_get_slot(device, 1) == 2);
+    CHECK(opendmx_get_slot(device, 2) == 9);
+    CHECK(opendmx_get_slot(device, 3) == 0);
+    
+    CHECK(opendmx_set_frame_hook(device, NULL, NULL, 0) == 0);
+    CHECK(opendmx_close_device(device) == 0);
+    return test_finish("test_schedule");
+}
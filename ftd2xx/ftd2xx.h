@@ -0,0 +1,115 @@
+//
+//  ftd2xx.h
+//  OpenDMX
+//
+//  A stand in for the parts of FTDI's D2XX API used by libOpenDMX. Functions succeed without touching any hardware and
+//  count how often they are called, so the D2XX backend can be built and exercised on machines without the driver.
+//  Build against it with `make FTD2XX_INCLUDE=ftd2xx` and link ftd2xx/libftd2xx_stub.a.
+//
+
+#ifndef ftd2xx_h
+#define ftd2xx_h
+
+typedef void            *FT_HANDLE;
+typedef unsigned long   FT_STATUS;
+typedef void            *PVOID;
+typedef void            *LPVOID;
+typedef unsigned int    DWORD;
+typedef DWORD           *LPDWORD;
+typedef unsigned int    ULONG;
+typedef unsigned short  USHORT;
+typedef unsigned char   UCHAR;
+
+#define FT_OK                       0
+#define FT_INVALID_HANDLE           1
+#define FT_DEVICE_NOT_FOUND         2
+#define FT_IO_ERROR                 4
+
+#define FT_OPEN_BY_SERIAL_NUMBER    1
+#define FT_OPEN_BY_DESCRIPTION      2
+
+#define FT_LIST_NUMBER_ONLY         0x80000000
+#define FT_LIST_BY_INDEX            0x40000000
+#define FT_LIST_ALL                 0x20000000
+
+#define FT_BITS_8                   (UCHAR)8
+#define FT_STOP_BITS_2              (UCHAR)2
+#define FT_PARITY_NONE              (UCHAR)0
+
+#define FT_FLOW_NONE                0x0000
+
+#define FT_PURGE_RX                 1
+#define FT_PURGE_TX                 2
+
+extern FT_STATUS FT_OpenEx (PVOID pArg1, DWORD Flags, FT_HANDLE *pHandle);
+extern FT_STATUS FT_Close (FT_HANDLE ftHandle);
+extern FT_STATUS FT_ListDevices (PVOID pArg1, PVOID pArg2, DWORD Flags);
+extern FT_STATUS FT_SetBaudRate (FT_HANDLE ftHandle, ULONG BaudRate);
+extern FT_STATUS FT_SetDataCharacteristics (FT_HANDLE ftHandle, UCHAR WordLength, UCHAR StopBits, UCHAR Parity);
+extern FT_STATUS FT_SetFlowControl (FT_HANDLE ftHandle, USHORT FlowControl, UCHAR XonChar, UCHAR XoffChar);
+extern FT_STATUS FT_ClrRts (FT_HANDLE ftHandle);
+extern FT_STATUS FT_SetLatencyTimer (FT_HANDLE ftHandle, UCHAR ucLatency);
+extern FT_STATUS FT_SetUSBParameters (FT_HANDLE ftHandle, ULONG ulInTransferSize, ULONG ulOutTransferSize);
+extern FT_STATUS FT_Purge (FT_HANDLE ftHandle, ULONG Mask);
+extern FT_STATUS FT_SetTimeouts (FT_HANDLE ftHandle, ULONG ReadTimeout, ULONG WriteTimeout);
+extern FT_STATUS FT_SetBreakOn (FT_HANDLE ftHandle);
+extern FT_STATUS FT_SetBreakOff (FT_HANDLE ftHandle);
+extern FT_STATUS FT_Write (FT_HANDLE ftHandle, LPVOID lpBuffer, DWORD dwBytesToWrite, LPDWORD lpBytesWritten);
+
+// MARK: Stub Only
+
+/**
+ *  Number of calls made to each function since the counts were last reset. Calls may be made from several threads at once,
+ *  the counts are updated atomically.
+ */
+struct ftd2xx_stub_counts {
+    unsigned long   open;
+    unsigned long   close;
+    unsigned long   list_devices;
+    unsigned long   set_baud_rate;
+    unsigned long   set_data_characteristics;
+    unsigned long   set_flow_control;
+    unsigned long   clr_rts;
+    unsigned long   set_latency_timer;
+    unsigned long   set_usb_parameters;
+    unsigned long   purge;
+    unsigned long   set_timeouts;
+    unsigned long   set_break_on;
+    unsigned long   set_break_off;
+    unsigned long   write;
+    unsigned long   bytes_written;
+};
+
+extern struct ftd2xx_stub_counts ftd2xx_stub_counts;
+
+/**
+ *  Number of devices reported by FT_ListDevices, their serial numbers are "STUB0", "STUB1" and so on.
+ */
+extern int ftd2xx_stub_num_devices;
+
+/**
+ *  Reset all of the call counts to zero.
+ */
+extern void ftd2xx_stub_reset (void);
+
+/**
+ *  Make every call on a device fail with FT_IO_ERROR, as if it had been unplugged.
+ *  @param serial_number The serial number the device was opened with.
+ *  @param failing 1 to make calls fail, 0 to make them succeed again.
+ */
+extern void ftd2xx_stub_set_failing (const char *serial_number, int failing);
+
+/**
+ *  Make writes to a device block before failing, as a device which has stopped responding does until its write timeout.
+ *  @param serial_number The serial number the device was opened with.
+ *  @param stall_time The time each FT_Write takes in nanoseconds before returning with nothing written, 0 to stop stalling.
+ */
+extern void ftd2xx_stub_set_stalling (const char *serial_number, long stall_time);
+
+/**
+ *  Get the number of successful writes made to a device, these are not cleared by ftd2xx_stub_reset.
+ *  @param serial_number The serial number the device was opened with.
+ */
+extern unsigned long ftd2xx_stub_device_writes (const char *serial_number);
+
+#endif /* ftd2xx_h */
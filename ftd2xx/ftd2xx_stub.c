@@ -0,0 +1,177 @@
+//
+//  ftd2xx_stub.c
+//  OpenDMX
+//
+//  Implementation of the D2XX stand in, see ftd2xx.h.
+//
+
+#define _XOPEN_SOURCE 800
+
+#include "ftd2xx.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define STUB_MAX_DEVICES    16
+#define STUB_SERIAL_LENGTH  64
+
+struct stub_device {
+    char    serial_number[STUB_SERIAL_LENGTH];
+    int     failing;
+    long    stall_time;     // Time each write blocks for before failing, 0 if the device is not stalled
+    unsigned long writes;   // Successful writes
+};
+
+#define COUNT(count) __atomic_fetch_add(&(count), 1, __ATOMIC_RELAXED)
+
+struct ftd2xx_stub_counts ftd2xx_stub_counts;
+int ftd2xx_stub_num_devices = 2;
+
+static struct stub_device devices[STUB_MAX_DEVICES];
+static int num_devices = 0;
+
+static struct stub_device *find_device (const char *serial_number) {
+    for (int i = 0; i < num_devices; i++) {
+        if (strncmp(devices[i].serial_number, serial_number, STUB_SERIAL_LENGTH) == 0) {
+            return &devices[i];
+        }
+    }
+    if (num_devices == STUB_MAX_DEVICES) {
+        return NULL;
+    }
+    struct stub_device *device = &devices[num_devices++];
+    snprintf(device->serial_number, STUB_SERIAL_LENGTH, "%s", serial_number);
+    device->failing = 0;
+    device->stall_time = 0;
+    device->writes = 0;
+    return device;
+}
+
+static FT_STATUS device_status (FT_HANDLE ftHandle) {
+    if (ftHandle == NULL) return FT_INVALID_HANDLE;
+    return __atomic_load_n(&((struct stub_device *)ftHandle)->failing, __ATOMIC_RELAXED) ? FT_IO_ERROR : FT_OK;
+}
+
+void ftd2xx_stub_reset (void) {
+    memset(&ftd2xx_stub_counts, 0, sizeof(ftd2xx_stub_counts));
+}
+
+void ftd2xx_stub_set_failing (const char *serial_number, int failing) {
+    struct stub_device *device = find_device(serial_number);
+    if (device != NULL) {
+        __atomic_store_n(&device->failing, failing, __ATOMIC_RELAXED);
+    }
+}
+
+void ftd2xx_stub_set_stalling (const char *serial_number, long stall_time) {
+    struct stub_device *device = find_device(serial_number);
+    if (device != NULL) {
+        __atomic_store_n(&device->stall_time, stall_time, __ATOMIC_RELAXED);
+    }
+}
+
+unsigned long ftd2xx_stub_device_writes (const char *serial_number) {
+    struct stub_device *device = find_device(serial_number);
+    return (device != NULL) ? __atomic_load_n(&device->writes, __ATOMIC_RELAXED) : 0;
+}
+
+FT_STATUS FT_OpenEx (PVOID pArg1, DWORD Flags, FT_HANDLE *pHandle) {
+    COUNT(ftd2xx_stub_counts.open);
+    struct stub_device *device = find_device((const char *)pArg1);
+    if ((device == NULL) || device->failing) {
+        return FT_DEVICE_NOT_FOUND;
+    }
+    *pHandle = device;
+    return FT_OK;
+}
+
+FT_STATUS FT_Close (FT_HANDLE ftHandle) {
+    COUNT(ftd2xx_stub_counts.close);
+    return (ftHandle != NULL) ? FT_OK : FT_INVALID_HANDLE;
+}
+
+FT_STATUS FT_ListDevices (PVOID pArg1, PVOID pArg2, DWORD Flags) {
+    COUNT(ftd2xx_stub_counts.list_devices);
+    if (Flags & FT_LIST_NUMBER_ONLY) {
+        *(DWORD *)pArg1 = ftd2xx_stub_num_devices;
+    } else if (Flags & FT_LIST_ALL) {
+        char **serial_numbers = pArg1;
+        for (int i = 0; i < ftd2xx_stub_num_devices; i++) {
+            snprintf(serial_numbers[i], STUB_SERIAL_LENGTH, "STUB%d", i);
+        }
+        *(DWORD *)pArg2 = ftd2xx_stub_num_devices;
+    }
+    return FT_OK;
+}
+
+FT_STATUS FT_SetBaudRate (FT_HANDLE ftHandle, ULONG BaudRate) {
+    COUNT(ftd2xx_stub_counts.set_baud_rate);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_SetDataCharacteristics (FT_HANDLE ftHandle, UCHAR WordLength, UCHAR StopBits, UCHAR Parity) {
+    COUNT(ftd2xx_stub_counts.set_data_characteristics);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_SetFlowControl (FT_HANDLE ftHandle, USHORT FlowControl, UCHAR XonChar, UCHAR XoffChar) {
+    COUNT(ftd2xx_stub_counts.set_flow_control);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_ClrRts (FT_HANDLE ftHandle) {
+    COUNT(ftd2xx_stub_counts.clr_rts);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_SetLatencyTimer (FT_HANDLE ftHandle, UCHAR ucLatency) {
+    COUNT(ftd2xx_stub_counts.set_latency_timer);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_SetUSBParameters (FT_HANDLE ftHandle, ULONG ulInTransferSize, ULONG ulOutTransferSize) {
+    COUNT(ftd2xx_stub_counts.set_usb_parameters);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_Purge (FT_HANDLE ftHandle, ULONG Mask) {
+    COUNT(ftd2xx_stub_counts.purge);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_SetTimeouts (FT_HANDLE ftHandle, ULONG ReadTimeout, ULONG WriteTimeout) {
+    COUNT(ftd2xx_stub_counts.set_timeouts);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_SetBreakOn (FT_HANDLE ftHandle) {
+    COUNT(ftd2xx_stub_counts.set_break_on);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_SetBreakOff (FT_HANDLE ftHandle) {
+    COUNT(ftd2xx_stub_counts.set_break_off);
+    return device_status(ftHandle);
+}
+
+FT_STATUS FT_Write (FT_HANDLE ftHandle, LPVOID lpBuffer, DWORD dwBytesToWrite, LPDWORD lpBytesWritten) {
+    COUNT(ftd2xx_stub_counts.write);
+    FT_STATUS status = device_status(ftHandle);
+    *lpBytesWritten = 0;
+    if (status != FT_OK) {
+        return status;
+    }
+    struct stub_device *device = ftHandle;
+    const long stall_time = __atomic_load_n(&device->stall_time, __ATOMIC_RELAXED);
+    if (stall_time > 0) {
+        // Like a real write timeout, the call succeeds but nothing is written
+        const struct timespec stall = { stall_time / 1000000000, stall_time % 1000000000 };
+        nanosleep(&stall, NULL);
+        return FT_OK;
+    }
+    *lpBytesWritten = dwBytesToWrite;
+    __atomic_fetch_add(&ftd2xx_stub_counts.bytes_written, dwBytesToWrite, __ATOMIC_RELAXED);
+    COUNT(device->writes);
+    return FT_OK;
+}